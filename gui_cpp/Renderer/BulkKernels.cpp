@@ -0,0 +1,380 @@
+#include "BulkKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// The AVX2 kernels are compiled whatever the target architecture of the
+// build and only run after DetectSimdLevel found AVX2. SSE2 is the baseline.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define BULK_AVX2
+#else
+#define BULK_AVX2 __attribute__((target("avx2")))
+#endif
+
+SimdLevel DetectSimdLevel()
+{
+    static const SimdLevel level = [] {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        // the OS has to save the ymm registers as well
+        if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5)) return SimdLevel::AVX2;
+        }
+        return SimdLevel::SSE2;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#endif
+    }();
+    return level;
+}
+
+// ---- scalar, also the fallback of the SIMD paths ----
+
+static inline void WriteQuad(Vertex* vtx, uint16_t* idx, uint16_t base,
+    float x0, float y0, float x1, float y1, float x2, float y2, float x3, float y3, uint32_t col)
+{
+    vtx[0] = { x0, y0, 0, 0, col };
+    vtx[1] = { x1, y1, 0, 0, col };
+    vtx[2] = { x2, y2, 0, 0, col };
+    vtx[3] = { x3, y3, 0, 0, col };
+    idx[0] = base;
+    idx[1] = (uint16_t)(base + 1);
+    idx[2] = (uint16_t)(base + 2);
+    idx[3] = (uint16_t)(base + 2);
+    idx[4] = (uint16_t)(base + 3);
+    idx[5] = base;
+}
+
+static inline size_t RectScalar(const Rect& r, uint32_t col, const Rect& clip, uint16_t base, Vertex* vtx, uint16_t* idx)
+{
+    if (!r.Overlaps(clip)) return 0;
+    WriteQuad(vtx, idx, base, r.left, r.top, r.right, r.top, r.right, r.bottom, r.left, r.bottom, col);
+    return 1;
+}
+
+static inline size_t PointScalar(Vec2 p, float h, uint32_t col, const Rect& clip, uint16_t base, Vertex* vtx, uint16_t* idx)
+{
+    Rect r = { p.x - h, p.y - h, p.x + h, p.y + h };
+    return RectScalar(r, col, clip, base, vtx, idx);
+}
+
+// same arithmetic, in the same order, as Renderer::AddLine
+static inline size_t LineScalar(Vec2 a, Vec2 b, float h, uint32_t col, const Rect& clip, uint16_t base, Vertex* vtx, uint16_t* idx)
+{
+    float dx = b.x - a.x;
+    float dy = b.y - a.y;
+    float len = std::sqrt(dx * dx + dy * dy);
+    if (!(len > 0.f)) return 0;     // zero length, or NaN in a coordinate
+
+    Rect bounds = { std::min(a.x, b.x) - h, std::min(a.y, b.y) - h, std::max(a.x, b.x) + h, std::max(a.y, b.y) + h };
+    if (!bounds.Overlaps(clip)) return 0;
+
+    float scale = h / len;
+    float nx = -dy * scale;
+    float ny = dx * scale;
+    WriteQuad(vtx, idx, base, a.x + nx, a.y + ny, b.x + nx, b.y + ny, b.x - nx, b.y - ny, a.x - nx, a.y - ny, col);
+    return 1;
+}
+
+static size_t ExpandRectsScalar(const Rect* rects, size_t count, const uint32_t* colors, size_t colorStride,
+    const Rect& clip, uint16_t base, Vertex* vtx, uint16_t* idx)
+{
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++)
+        written += RectScalar(rects[i], colors[i * colorStride], clip, (uint16_t)(base + written * 4), vtx + written * 4, idx + written * 6);
+    return written;
+}
+
+static size_t ExpandPointsScalar(const Vec2* points, size_t count, const uint32_t* colors, size_t colorStride,
+    float h, const Rect& clip, uint16_t base, Vertex* vtx, uint16_t* idx)
+{
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++)
+        written += PointScalar(points[i], h, colors[i * colorStride], clip, (uint16_t)(base + written * 4), vtx + written * 4, idx + written * 6);
+    return written;
+}
+
+static size_t ExpandLinesScalar(const Vec2* endpoints, size_t count, const uint32_t* colors, size_t colorStride,
+    float h, const Rect& clip, uint16_t base, Vertex* vtx, uint16_t* idx)
+{
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++)
+        written += LineScalar(endpoints[2 * i], endpoints[2 * i + 1], h, colors[i * colorStride], clip,
+            (uint16_t)(base + written * 4), vtx + written * 4, idx + written * 6);
+    return written;
+}
+
+// ---- SSE2, four quads per step ----
+
+// (0, 0, 0, col): the zero uv and the colour of a vertex
+static inline __m128 ColorLanes(uint32_t col)
+{
+    return _mm_castsi128_ps(_mm_set_epi32((int)col, 0, 0, 0));
+}
+
+// rect (left, top, right, bottom) -> the 4 vertices WriteQuad writes
+static inline void StoreRectSSE(Vertex* vtx, __m128 rect, uint32_t col)
+{
+    __m128 c = ColorLanes(col);
+    _mm_storeu_ps(&vtx[0].x, _mm_shuffle_ps(rect, c, _MM_SHUFFLE(3, 2, 1, 0)));
+    _mm_storeu_ps(&vtx[1].x, _mm_shuffle_ps(rect, c, _MM_SHUFFLE(3, 2, 1, 2)));
+    _mm_storeu_ps(&vtx[2].x, _mm_shuffle_ps(rect, c, _MM_SHUFFLE(3, 2, 3, 2)));
+    _mm_storeu_ps(&vtx[3].x, _mm_shuffle_ps(rect, c, _MM_SHUFFLE(3, 2, 3, 0)));
+}
+
+// the 24 indices of 4 consecutive quads
+static inline void StoreIndices4SSE(uint16_t* idx, uint16_t base)
+{
+    __m128i b = _mm_set1_epi16((short)base);
+    _mm_storeu_si128((__m128i*)idx, _mm_add_epi16(b, _mm_setr_epi16(0, 1, 2, 2, 3, 0, 4, 5)));
+    _mm_storeu_si128((__m128i*)(idx + 8), _mm_add_epi16(b, _mm_setr_epi16(6, 6, 7, 4, 8, 9, 10, 10)));
+    _mm_storeu_si128((__m128i*)(idx + 16), _mm_add_epi16(b, _mm_setr_epi16(11, 8, 12, 13, 14, 14, 15, 12)));
+}
+
+// bit k set when rect k overlaps clip, Rect::Overlaps four at a time
+static inline int OverlapMask4(__m128 r0, __m128 r1, __m128 r2, __m128 r3, const Rect& clip)
+{
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);      // lefts, tops, rights, bottoms
+    __m128 m = _mm_and_ps(_mm_cmplt_ps(r0, _mm_set1_ps(clip.right)), _mm_cmplt_ps(_mm_set1_ps(clip.left), r2));
+    m = _mm_and_ps(m, _mm_and_ps(_mm_cmplt_ps(r1, _mm_set1_ps(clip.bottom)), _mm_cmplt_ps(_mm_set1_ps(clip.top), r3)));
+    return _mm_movemask_ps(m);
+}
+
+// squares around points p0 and p1 of (x0, y0, x1, y1)
+static inline void PointRectsSSE(__m128 pair, __m128 offset, __m128& r0, __m128& r1)
+{
+    r0 = _mm_add_ps(_mm_shuffle_ps(pair, pair, _MM_SHUFFLE(1, 0, 1, 0)), offset);
+    r1 = _mm_add_ps(_mm_shuffle_ps(pair, pair, _MM_SHUFFLE(3, 2, 3, 2)), offset);
+}
+
+static size_t ExpandRectsSSE2(const Rect* rects, size_t count, const uint32_t* colors, size_t colorStride,
+    const Rect& clip, uint16_t base, Vertex* vtx, uint16_t* idx)
+{
+    size_t written = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 r[4];
+        for (int k = 0; k < 4; k++) r[k] = _mm_loadu_ps(&rects[i + k].left);
+
+        if (OverlapMask4(r[0], r[1], r[2], r[3], clip) != 15) {
+            written += ExpandRectsScalar(rects + i, 4, colors + i * colorStride, colorStride, clip,
+                (uint16_t)(base + written * 4), vtx + written * 4, idx + written * 6);
+            continue;
+        }
+        for (int k = 0; k < 4; k++) StoreRectSSE(vtx + (written + k) * 4, r[k], colors[(i + k) * colorStride]);
+        StoreIndices4SSE(idx + written * 6, (uint16_t)(base + written * 4));
+        written += 4;
+    }
+    written += ExpandRectsScalar(rects + i, count - i, colors + i * colorStride, colorStride, clip,
+        (uint16_t)(base + written * 4), vtx + written * 4, idx + written * 6);
+    return written;
+}
+
+static size_t ExpandPointsSSE2(const Vec2* points, size_t count, const uint32_t* colors, size_t colorStride,
+    float h, const Rect& clip, uint16_t base, Vertex* vtx, uint16_t* idx)
+{
+    // x - h is x + (-h) exactly, so this matches PointScalar
+    __m128 offset = _mm_setr_ps(-h, -h, h, h);
+    size_t written = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 r[4];
+        PointRectsSSE(_mm_loadu_ps(&points[i].x), offset, r[0], r[1]);
+        PointRectsSSE(_mm_loadu_ps(&points[i + 2].x), offset, r[2], r[3]);
+
+        if (OverlapMask4(r[0], r[1], r[2], r[3], clip) != 15) {
+            written += ExpandPointsScalar(points + i, 4, colors + i * colorStride, colorStride, h, clip,
+                (uint16_t)(base + written * 4), vtx + written * 4, idx + written * 6);
+            continue;
+        }
+        for (int k = 0; k < 4; k++) StoreRectSSE(vtx + (written + k) * 4, r[k], colors[(i + k) * colorStride]);
+        StoreIndices4SSE(idx + written * 6, (uint16_t)(base + written * 4));
+        written += 4;
+    }
+    written += ExpandPointsScalar(points + i, count - i, colors + i * colorStride, colorStride, h, clip,
+        (uint16_t)(base + written * 4), vtx + written * 4, idx + written * 6);
+    return written;
+}
+
+// one corner (xs, ys of four lines) into vertex slot of each line's quad
+static inline void StoreCornerSSE(Vertex* vtx, int slot, __m128 xs, __m128 ys, const __m128 c[4])
+{
+    __m128 lo = _mm_unpacklo_ps(xs, ys);    // x0 y0 x1 y1
+    __m128 hi = _mm_unpackhi_ps(xs, ys);    // x2 y2 x3 y3
+    _mm_storeu_ps(&vtx[0 * 4 + slot].x, _mm_shuffle_ps(lo, c[0], _MM_SHUFFLE(3, 2, 1, 0)));
+    _mm_storeu_ps(&vtx[1 * 4 + slot].x, _mm_shuffle_ps(lo, c[1], _MM_SHUFFLE(3, 2, 3, 2)));
+    _mm_storeu_ps(&vtx[2 * 4 + slot].x, _mm_shuffle_ps(hi, c[2], _MM_SHUFFLE(3, 2, 1, 0)));
+    _mm_storeu_ps(&vtx[3 * 4 + slot].x, _mm_shuffle_ps(hi, c[3], _MM_SHUFFLE(3, 2, 3, 2)));
+}
+
+static size_t ExpandLinesSSE2(const Vec2* endpoints, size_t count, const uint32_t* colors, size_t colorStride,
+    float h, const Rect& clip, uint16_t base, Vertex* vtx, uint16_t* idx)
+{
+    __m128 half = _mm_set1_ps(h);
+    __m128 zero = _mm_setzero_ps();
+    __m128 signBit = _mm_set1_ps(-0.f);
+    size_t written = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // a line is 4 floats like a rect: x0 y0 x1 y1
+        __m128 x0 = _mm_loadu_ps(&endpoints[2 * i].x);
+        __m128 y0 = _mm_loadu_ps(&endpoints[2 * i + 2].x);
+        __m128 x1 = _mm_loadu_ps(&endpoints[2 * i + 4].x);
+        __m128 y1 = _mm_loadu_ps(&endpoints[2 * i + 6].x);
+        _MM_TRANSPOSE4_PS(x0, y0, x1, y1);
+
+        __m128 dx = _mm_sub_ps(x1, x0);
+        __m128 dy = _mm_sub_ps(y1, y0);
+        __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+
+        __m128 left = _mm_sub_ps(_mm_min_ps(x0, x1), half);
+        __m128 top = _mm_sub_ps(_mm_min_ps(y0, y1), half);
+        __m128 right = _mm_add_ps(_mm_max_ps(x0, x1), half);
+        __m128 bottom = _mm_add_ps(_mm_max_ps(y0, y1), half);
+        // ordered compare like the scalar test: NaN lanes fail it, and with
+        // no NaN left min and max agree with std::min and std::max
+        __m128 m = _mm_cmpgt_ps(len, zero);
+        m = _mm_and_ps(m, _mm_and_ps(_mm_cmplt_ps(left, _mm_set1_ps(clip.right)), _mm_cmplt_ps(_mm_set1_ps(clip.left), right)));
+        m = _mm_and_ps(m, _mm_and_ps(_mm_cmplt_ps(top, _mm_set1_ps(clip.bottom)), _mm_cmplt_ps(_mm_set1_ps(clip.top), bottom)));
+        if (_mm_movemask_ps(m) != 15) {
+            written += ExpandLinesScalar(endpoints + 2 * i, 4, colors + i * colorStride, colorStride, h, clip,
+                (uint16_t)(base + written * 4), vtx + written * 4, idx + written * 6);
+            continue;
+        }
+
+        __m128 scale = _mm_div_ps(half, len);
+        __m128 nx = _mm_mul_ps(_mm_xor_ps(dy, signBit), scale);
+        __m128 ny = _mm_mul_ps(dx, scale);
+
+        __m128 c[4];
+        for (int k = 0; k < 4; k++) c[k] = ColorLanes(colors[(i + k) * colorStride]);
+        Vertex* out = vtx + written * 4;
+        StoreCornerSSE(out, 0, _mm_add_ps(x0, nx), _mm_add_ps(y0, ny), c);
+        StoreCornerSSE(out, 1, _mm_add_ps(x1, nx), _mm_add_ps(y1, ny), c);
+        StoreCornerSSE(out, 2, _mm_sub_ps(x1, nx), _mm_sub_ps(y1, ny), c);
+        StoreCornerSSE(out, 3, _mm_sub_ps(x0, nx), _mm_sub_ps(y0, ny), c);
+        StoreIndices4SSE(idx + written * 6, (uint16_t)(base + written * 4));
+        written += 4;
+    }
+    written += ExpandLinesScalar(endpoints + 2 * i, count - i, colors + i * colorStride, colorStride, h, clip,
+        (uint16_t)(base + written * 4), vtx + written * 4, idx + written * 6);
+    return written;
+}
+
+// ---- AVX2, the vertices of two quads and 16 indices per store ----
+
+BULK_AVX2 static inline void StoreRectPairAVX2(Vertex* vtx, __m128 a, __m128 b, uint32_t colA, uint32_t colB)
+{
+    __m256 rects = _mm256_insertf128_ps(_mm256_castps128_ps256(a), b, 1);
+    __m256 c = _mm256_castsi256_ps(_mm256_setr_epi32(0, 0, 0, (int)colA, 0, 0, 0, (int)colB));
+    __m256 v0 = _mm256_shuffle_ps(rects, c, _MM_SHUFFLE(3, 2, 1, 0));
+    __m256 v1 = _mm256_shuffle_ps(rects, c, _MM_SHUFFLE(3, 2, 1, 2));
+    __m256 v2 = _mm256_shuffle_ps(rects, c, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 v3 = _mm256_shuffle_ps(rects, c, _MM_SHUFFLE(3, 2, 3, 0));
+    _mm256_storeu_ps(&vtx[0].x, _mm256_permute2f128_ps(v0, v1, 0x20));
+    _mm256_storeu_ps(&vtx[2].x, _mm256_permute2f128_ps(v2, v3, 0x20));
+    _mm256_storeu_ps(&vtx[4].x, _mm256_permute2f128_ps(v0, v1, 0x31));
+    _mm256_storeu_ps(&vtx[6].x, _mm256_permute2f128_ps(v2, v3, 0x31));
+}
+
+BULK_AVX2 static inline void StoreIndices4AVX2(uint16_t* idx, uint16_t base)
+{
+    __m256i b = _mm256_set1_epi16((short)base);
+    _mm256_storeu_si256((__m256i*)idx, _mm256_add_epi16(b, _mm256_setr_epi16(0, 1, 2, 2, 3, 0, 4, 5, 6, 6, 7, 4, 8, 9, 10, 10)));
+    _mm_storeu_si128((__m128i*)(idx + 16), _mm_add_epi16(_mm256_castsi256_si128(b), _mm_setr_epi16(11, 8, 12, 13, 14, 14, 15, 12)));
+}
+
+BULK_AVX2 static inline void StoreRects4AVX2(Vertex* vtx, uint16_t* idx, uint16_t base, const __m128 r[4], const uint32_t* colors, size_t colorStride)
+{
+    StoreRectPairAVX2(vtx, r[0], r[1], colors[0], colors[colorStride]);
+    StoreRectPairAVX2(vtx + 8, r[2], r[3], colors[2 * colorStride], colors[3 * colorStride]);
+    StoreIndices4AVX2(idx, base);
+}
+
+BULK_AVX2 static size_t ExpandRectsAVX2(const Rect* rects, size_t count, const uint32_t* colors, size_t colorStride,
+    const Rect& clip, uint16_t base, Vertex* vtx, uint16_t* idx)
+{
+    size_t written = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 r[4];
+        for (int k = 0; k < 4; k++) r[k] = _mm_loadu_ps(&rects[i + k].left);
+
+        if (OverlapMask4(r[0], r[1], r[2], r[3], clip) != 15) {
+            written += ExpandRectsScalar(rects + i, 4, colors + i * colorStride, colorStride, clip,
+                (uint16_t)(base + written * 4), vtx + written * 4, idx + written * 6);
+            continue;
+        }
+        StoreRects4AVX2(vtx + written * 4, idx + written * 6, (uint16_t)(base + written * 4), r, colors + i * colorStride, colorStride);
+        written += 4;
+    }
+    written += ExpandRectsScalar(rects + i, count - i, colors + i * colorStride, colorStride, clip,
+        (uint16_t)(base + written * 4), vtx + written * 4, idx + written * 6);
+    return written;
+}
+
+BULK_AVX2 static size_t ExpandPointsAVX2(const Vec2* points, size_t count, const uint32_t* colors, size_t colorStride,
+    float h, const Rect& clip, uint16_t base, Vertex* vtx, uint16_t* idx)
+{
+    __m128 offset = _mm_setr_ps(-h, -h, h, h);
+    size_t written = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 r[4];
+        PointRectsSSE(_mm_loadu_ps(&points[i].x), offset, r[0], r[1]);
+        PointRectsSSE(_mm_loadu_ps(&points[i + 2].x), offset, r[2], r[3]);
+
+        if (OverlapMask4(r[0], r[1], r[2], r[3], clip) != 15) {
+            written += ExpandPointsScalar(points + i, 4, colors + i * colorStride, colorStride, h, clip,
+                (uint16_t)(base + written * 4), vtx + written * 4, idx + written * 6);
+            continue;
+        }
+        StoreRects4AVX2(vtx + written * 4, idx + written * 6, (uint16_t)(base + written * 4), r, colors + i * colorStride, colorStride);
+        written += 4;
+    }
+    written += ExpandPointsScalar(points + i, count - i, colors + i * colorStride, colorStride, h, clip,
+        (uint16_t)(base + written * 4), vtx + written * 4, idx + written * 6);
+    return written;
+}
+
+// ---- dispatch ----
+
+size_t ExpandRects(SimdLevel level, const Rect* rects, size_t count, const uint32_t* colors, size_t colorStride,
+    const Rect& clip, uint16_t baseIndex, Vertex* vtx, uint16_t* idx)
+{
+    switch (level) {
+    case SimdLevel::AVX2: return ExpandRectsAVX2(rects, count, colors, colorStride, clip, baseIndex, vtx, idx);
+    case SimdLevel::SSE2: return ExpandRectsSSE2(rects, count, colors, colorStride, clip, baseIndex, vtx, idx);
+    default: return ExpandRectsScalar(rects, count, colors, colorStride, clip, baseIndex, vtx, idx);
+    }
+}
+
+size_t ExpandPoints(SimdLevel level, const Vec2* points, size_t count, const uint32_t* colors, size_t colorStride,
+    float halfSize, const Rect& clip, uint16_t baseIndex, Vertex* vtx, uint16_t* idx)
+{
+    switch (level) {
+    case SimdLevel::AVX2: return ExpandPointsAVX2(points, count, colors, colorStride, halfSize, clip, baseIndex, vtx, idx);
+    case SimdLevel::SSE2: return ExpandPointsSSE2(points, count, colors, colorStride, halfSize, clip, baseIndex, vtx, idx);
+    default: return ExpandPointsScalar(points, count, colors, colorStride, halfSize, clip, baseIndex, vtx, idx);
+    }
+}
+
+size_t ExpandLines(SimdLevel level, const Vec2* endpoints, size_t count, const uint32_t* colors, size_t colorStride,
+    float halfThickness, const Rect& clip, uint16_t baseIndex, Vertex* vtx, uint16_t* idx)
+{
+    // lines are bound by the divide and square root, which AVX2 does not
+    // speed up over four lanes, so they share the SSE2 kernel
+    if (level == SimdLevel::Scalar)
+        return ExpandLinesScalar(endpoints, count, colors, colorStride, halfThickness, clip, baseIndex, vtx, idx);
+    return ExpandLinesSSE2(endpoints, count, colors, colorStride, halfThickness, clip, baseIndex, vtx, idx);
+}
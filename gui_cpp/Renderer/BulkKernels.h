@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "RendererPrimitives.h"
+
+// Instruction sets the bulk kernels can use, in increasing order
+enum class SimdLevel { Scalar, SSE2, AVX2 };
+
+// Best level the CPU and the OS support, checked once
+SimdLevel DetectSimdLevel();
+
+// Expansion of many quads at once for the bulk Add* calls. Every primitive
+// whose bounds overlap clip becomes 4 vertices and the 6 indices of
+// DrawList::PrimQuad, numbered from baseIndex on, the others are skipped.
+// The SIMD paths fall back to the scalar code for groups with a skipped
+// primitive, so all levels write byte-identical output. colorStride is 1
+// for one colour per primitive, 0 for one shared colour. vtx and idx need
+// room for count quads. Returns the number of quads written.
+
+// rects as they are, right/bottom exclusive
+size_t ExpandRects(SimdLevel level, const Rect* rects, size_t count, const uint32_t* colors, size_t colorStride,
+    const Rect& clip, uint16_t baseIndex, Vertex* vtx, uint16_t* idx);
+
+// squares of 2 * halfSize around the points
+size_t ExpandPoints(SimdLevel level, const Vec2* points, size_t count, const uint32_t* colors, size_t colorStride,
+    float halfSize, const Rect& clip, uint16_t baseIndex, Vertex* vtx, uint16_t* idx);
+
+// segments endpoints[2i] -> endpoints[2i + 1], the quads of Renderer::AddLine
+// (zero-length segments and ones with a NaN coordinate are skipped like there)
+size_t ExpandLines(SimdLevel level, const Vec2* endpoints, size_t count, const uint32_t* colors, size_t colorStride,
+    float halfThickness, const Rect& clip, uint16_t baseIndex, Vertex* vtx, uint16_t* idx);
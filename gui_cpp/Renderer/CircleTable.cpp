@@ -0,0 +1,63 @@
+#include "CircleTable.h"
+#include <cmath>
+#include <algorithm>
+
+CircleTable::CircleTable(float error)
+    : pendingError(error)
+{
+    ApplyMaxError();
+}
+
+void CircleTable::SetMaxError(float error)
+{
+    pendingError.store(error, std::memory_order_release);
+}
+
+bool CircleTable::ApplyMaxError()
+{
+    float error = std::max(pendingError.load(std::memory_order_acquire), 0.01f);
+    if (error == maxError) return false;
+
+    maxError = error;
+    for (int r = 0; r < 256; r++)
+        radiusLUT[r] = (uint16_t)ComputeSegmentCount((float)r, maxError);
+    return true;
+}
+
+int CircleTable::ComputeSegmentCount(float radius, float error)
+{
+    if (radius <= error) return MinSegments;
+
+    // sagitta of one segment: r * (1 - cos(pi / n)) <= error
+    float n = 3.14159265358979323846f / std::acos(1.f - std::min(error, radius) / radius);
+    int segments = ((int)std::ceil(n) + 3) & ~3;
+    return std::clamp(segments, MinSegments, MaxSegments);
+}
+
+int CircleTable::SegmentCount(float radius) const
+{
+    // round the radius up so the tolerance holds for non-integer radii too
+    int r = (int)std::ceil(radius);
+    if (r < 0) return MinSegments;
+    if (r < 256) return radiusLUT[r];
+    return ComputeSegmentCount(radius, maxError);
+}
+
+const Vec2* CircleTable::UnitCircle(int segments)
+{
+    segments = std::clamp(segments, 3, MaxSegments);
+
+    const Vec2* built = ready[segments].load(std::memory_order_acquire);
+    if (built) return built;
+
+    std::lock_guard<std::mutex> lock(buildMutex);
+    std::vector<Vec2>& table = tables[segments];
+    if (table.empty()) {
+        table.resize(segments);
+        double step = 2.0 * 3.14159265358979323846 / segments;
+        for (int i = 0; i < segments; i++)
+            table[i] = { (float)std::cos(i * step), (float)std::sin(i * step) };
+    }
+    ready[segments].store(table.data(), std::memory_order_release);
+    return table.data();
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+
+#include "RendererPrimitives.h"
+
+// Precomputed unit circles shared by every circle and arc primitive, plus the
+// segment count a given radius needs to stay within a pixel error tolerance.
+class CircleTable {
+public:
+    static constexpr int MinSegments = 4;
+    static constexpr int MaxSegments = 512;
+
+    explicit CircleTable(float maxError = 0.3f);
+
+    // Largest distance in pixels allowed between the true circle and its
+    // polygon. Smaller values give more segments. Safe to call from any
+    // thread: the value is only taken over by the next ApplyMaxError().
+    void SetMaxError(float maxError);
+    float GetMaxError() const { return maxError; }
+
+    // Rebuilds the segment counts for a pending SetMaxError, true when they
+    // changed. Must not run while other threads call SegmentCount.
+    bool ApplyMaxError();
+
+    // Segments for a full circle of this radius, a multiple of 4 so quadrant
+    // boundaries are always sampled exactly.
+    int SegmentCount(float radius) const;
+
+    // `segments` points (cos, sin) of angles 2*pi*i/segments, i.e. clockwise
+    // on screen starting at +x. Built on first use and kept, safe to call
+    // from several threads.
+    const Vec2* UnitCircle(int segments);
+
+private:
+    static int ComputeSegmentCount(float radius, float maxError);
+
+    float maxError = -1.f;
+    std::atomic<float> pendingError;
+    uint16_t radiusLUT[256];        // integer radius -> segment count
+    std::vector<Vec2> tables[MaxSegments + 1];
+    std::atomic<const Vec2*> ready[MaxSegments + 1] = {};   // set once a table is built
+    std::mutex buildMutex;
+};
@@ -0,0 +1,180 @@
+#include "DamageTracker.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cmath>
+
+// union of the x, y, w, h boxes of an instance run
+template <typename T>
+static Rect InstanceBounds(const T* inst, UINT count)
+{
+    Rect bounds = { inst[0].x, inst[0].y, inst[0].x + inst[0].w, inst[0].y + inst[0].h };
+    for (UINT i = 1; i < count; i++) {
+        bounds.left = std::min(bounds.left, inst[i].x);
+        bounds.top = std::min(bounds.top, inst[i].y);
+        bounds.right = std::max(bounds.right, inst[i].x + inst[i].w);
+        bounds.bottom = std::max(bounds.bottom, inst[i].y + inst[i].h);
+    }
+    return bounds;
+}
+
+void DamageTracker::BuildItems(const DrawList& list, std::vector<Item>& out) const
+{
+    out.clear();
+    const std::vector<DrawCommand>& cmds = list.cmdBuffer;
+
+    for (size_t i = 0; i < cmds.size(); i++) {
+        const DrawCommand& cmd = cmds[i];
+        if (cmd.IsEmpty()) continue;
+
+        if (cmd.instCount > 0) {
+            // the extra pixel also covers the fringe of shape quads
+            Rect bounds = cmd.shapeInstances
+                ? InstanceBounds(list.shapeBuffer.data() + cmd.instOffset, cmd.instCount)
+                : InstanceBounds(list.instBuffer.data() + cmd.instOffset, cmd.instCount);
+            bounds = { std::floor(bounds.left) - 1.f, std::floor(bounds.top) - 1.f,
+                       std::ceil(bounds.right) + 1.f, std::ceil(bounds.bottom) + 1.f };
+            bounds = bounds.Intersect(cmd.clipRect).Intersect(viewport);
+            if (bounds.IsEmpty()) continue;
+
+            uint64_t hash = cmd.shapeInstances
+                ? HashBuffer(list.shapeBuffer.data() + cmd.instOffset, cmd.instCount * sizeof(ShapeInstance))
+                : HashBuffer(list.instBuffer.data() + cmd.instOffset, cmd.instCount * sizeof(RectInstance));
+            hash = HashValue(cmd.instVertexCount, hash);
+            hash = HashValue(cmd.shapeInstances, hash);
+            hash = HashValue(cmd.texture, hash);
+            hash = HashValue(bounds, hash);
+            out.push_back({ hash, bounds, cmd.texture });
+            continue;
+        }
+
+        // commands own consecutive vertex ranges
+        size_t vtxEnd = i + 1 < cmds.size() ? cmds[i + 1].vtxOffset : list.vtxBuffer.size();
+        const Vertex* vtx = list.vtxBuffer.data() + cmd.vtxOffset;
+        size_t vtxCount = vtxEnd - cmd.vtxOffset;
+        if (vtxCount == 0) continue;
+
+        Rect bounds = { vtx[0].x, vtx[0].y, vtx[0].x, vtx[0].y };
+        for (size_t v = 1; v < vtxCount; v++) {
+            bounds.left = std::min(bounds.left, vtx[v].x);
+            bounds.top = std::min(bounds.top, vtx[v].y);
+            bounds.right = std::max(bounds.right, vtx[v].x);
+            bounds.bottom = std::max(bounds.bottom, vtx[v].y);
+        }
+
+        // whole pixels plus one for rasterisation and filtering at the edges
+        bounds = { std::floor(bounds.left) - 1.f, std::floor(bounds.top) - 1.f,
+                   std::ceil(bounds.right) + 1.f, std::ceil(bounds.bottom) + 1.f };
+        bounds = bounds.Intersect(cmd.clipRect).Intersect(viewport);
+        if (bounds.IsEmpty()) continue;
+
+        uint64_t hash = HashBuffer(vtx, vtxCount * sizeof(Vertex));
+        hash = HashBuffer(list.idxBuffer.data() + cmd.idxOffset, cmd.elemCount * sizeof(DrawIndex), hash);
+        hash = HashValue(cmd.texture, hash);
+        hash = HashValue(bounds, hash);
+        out.push_back({ hash, bounds, cmd.texture });
+    }
+}
+
+void DamageTracker::Update(const DrawList& list, int viewportWidth, int viewportHeight)
+{
+    Rect newViewport = { 0.f, 0.f, (float)viewportWidth, (float)viewportHeight };
+    if (newViewport != viewport) {
+        viewport = newViewport;
+        invalidated = true;
+    }
+
+    BuildItems(list, current);
+    dirtyRects.clear();
+    dirtyArea = 0.f;
+    fullRedraw = invalidated;
+    invalidated = false;
+
+    if (!fullRedraw) {
+        lookup.clear();
+        for (int i = 0; i < (int)previous.size(); i++)
+            lookup.push_back({ previous[i].hash, i });
+        std::sort(lookup.begin(), lookup.end());
+        matched.assign(previous.size(), 0);
+
+        // an item found earlier in the previous frame than one already
+        // matched has changed its stacking order
+        int maxPrevious = -1;
+        for (const Item& item : current) {
+            auto it = std::lower_bound(lookup.begin(), lookup.end(), std::make_pair(item.hash, 0));
+            while (it != lookup.end() && it->first == item.hash && matched[it->second]) ++it;
+
+            if (it == lookup.end() || it->first != item.hash) {
+                AddDamage(item.bounds);
+                continue;
+            }
+
+            matched[it->second] = 1;
+            if (it->second < maxPrevious) AddDamage(item.bounds);
+            maxPrevious = std::max(maxPrevious, it->second);
+        }
+
+        for (size_t i = 0; i < previous.size(); i++) {
+            if (!matched[i]) AddDamage(previous[i].bounds);
+        }
+
+        // same geometry, new pixels
+        for (const Item& item : current) {
+            if (std::find(changedTextures.begin(), changedTextures.end(), item.texture) != changedTextures.end())
+                AddDamage(item.bounds);
+        }
+
+        MergeRects();
+
+        float viewportArea = viewport.right * viewport.bottom;
+        for (const Rect& r : dirtyRects)
+            dirtyArea += (r.right - r.left) * (r.bottom - r.top);
+        if (viewportArea <= 0.f || dirtyArea > viewportArea * fullRedrawThreshold)
+            fullRedraw = true;
+    }
+
+    if (fullRedraw) {
+        dirtyRects.clear();
+        dirtyArea = viewport.right * viewport.bottom;
+    }
+
+    changedTextures.clear();
+    std::swap(previous, current);
+}
+
+void DamageTracker::AddDamage(const Rect& r)
+{
+    if (!r.IsEmpty()) dirtyRects.push_back(r);
+}
+
+// Unions overlapping rects until none overlap, then collapses everything into
+// one rect if there are still too many to scissor individually
+void DamageTracker::MergeRects()
+{
+    // heavy damage ends up as one big rect anyway, skip the pairwise pass
+    bool merged = (int)dirtyRects.size() <= MaxRects * 8;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < dirtyRects.size() && !merged; i++) {
+            for (size_t j = i + 1; j < dirtyRects.size(); j++) {
+                if (!dirtyRects[i].Overlaps(dirtyRects[j])) continue;
+
+                Rect& a = dirtyRects[i];
+                const Rect& b = dirtyRects[j];
+                a = { std::min(a.left, b.left), std::min(a.top, b.top),
+                      std::max(a.right, b.right), std::max(a.bottom, b.bottom) };
+                dirtyRects.erase(dirtyRects.begin() + j);
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    if ((int)dirtyRects.size() > MaxRects) {
+        Rect all = dirtyRects[0];
+        for (const Rect& r : dirtyRects) {
+            all = { std::min(all.left, r.left), std::min(all.top, r.top),
+                    std::max(all.right, r.right), std::max(all.bottom, r.bottom) };
+        }
+        dirtyRects.assign(1, all);
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#include "DrawList.h"
+
+// Works out which parts of the screen changed between two frames by diffing
+// the draw commands: a command whose geometry, texture and clip hash was not
+// in the previous frame damages its bounds, one that disappeared damages its
+// old bounds, and one that moved in front of another damages its own. Pure
+// CPU, so results can be checked without a device.
+class DamageTracker {
+public:
+    static constexpr int MaxRects = 8;          // more than this are merged into one
+
+    // Damage covering more than this fraction of the viewport redraws it all
+    void SetFullRedrawThreshold(float fraction) { fullRedrawThreshold = fraction; }
+
+    // Next Update reports a full redraw (first frame, resize, lost contents)
+    void Invalidate() { invalidated = true; }
+
+    // Next Update damages everything drawn with this texture, for contents
+    // that changed under the same geometry
+    void InvalidateTexture(ID3D11ShaderResourceView* texture) { changedTextures.push_back(texture); }
+
+    // Diffs the list against the one passed to the previous call
+    void Update(const DrawList& list, int viewportWidth, int viewportHeight);
+
+    bool IsFullRedraw() const { return fullRedraw; }
+    bool IsClean() const { return !fullRedraw && dirtyRects.empty(); }
+
+    // Whole pixels, clamped to the viewport, not overlapping each other.
+    // Empty when nothing changed or on a full redraw.
+    const std::vector<Rect>& GetDirtyRects() const { return dirtyRects; }
+    float GetDirtyArea() const { return dirtyArea; }
+
+private:
+    struct Item {
+        uint64_t hash;
+        Rect bounds;
+        ID3D11ShaderResourceView* texture;
+    };
+
+    void BuildItems(const DrawList& list, std::vector<Item>& out) const;
+    void AddDamage(const Rect& r);
+    void MergeRects();
+
+    float fullRedrawThreshold = 0.6f;
+    bool invalidated = true;
+    bool fullRedraw = true;
+    float dirtyArea = 0.f;
+    Rect viewport = { 0.f, 0.f, 0.f, 0.f };
+
+    std::vector<Item> previous;
+    std::vector<Item> current;
+    std::vector<std::pair<uint64_t, int>> lookup;   // previous hashes, sorted
+    std::vector<uint8_t> matched;                   // per previous item
+    std::vector<Rect> dirtyRects;
+    std::vector<ID3D11ShaderResourceView*> changedTextures;
+};
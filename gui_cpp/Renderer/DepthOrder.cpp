@@ -0,0 +1,91 @@
+#include "DepthOrder.h"
+#include <algorithm>
+
+static bool IsOpaqueVertex(const Vertex& v)
+{
+    return v.u == 0 && v.v == 0 && (v.col >> 24) == 255;
+}
+
+bool DepthOrder::IsOpaque(const DrawList& list, const DrawCommand& cmd)
+{
+    if (cmd.texture) return false;
+
+    if (cmd.instCount > 0) {
+        if (cmd.shapeInstances) return false;
+        const RectInstance* rects = list.instBuffer.data() + cmd.instOffset;
+        for (UINT i = 0; i < cmd.instCount; i++) {
+            if ((rects[i].col >> 24) != 255) return false;
+        }
+        return true;
+    }
+
+    // only the vertices the indices reach, the range may hold others
+    const Vertex* vtx = list.vtxBuffer.data() + cmd.vtxOffset;
+    const DrawIndex* idx = list.idxBuffer.data() + cmd.idxOffset;
+    for (UINT i = 0; i < cmd.elemCount; i++) {
+        if (!IsOpaqueVertex(vtx[idx[i]])) return false;
+    }
+    return true;
+}
+
+DrawCommand DepthOrder::Slice(const DrawList& list, const DepthRun& run)
+{
+    DrawCommand cmd = list.cmdBuffer[run.command];
+    if (cmd.instCount == 0) {
+        cmd.idxOffset = run.idxOffset;
+        cmd.elemCount = run.elemCount;
+    }
+    return cmd;
+}
+
+void DepthOrder::Build(const DrawList& list)
+{
+    runs.clear();
+    opaque.clear();
+    translucent.clear();
+    stats = DepthOrderStats();
+
+    const std::vector<DrawCommand>& cmds = list.cmdBuffer;
+    for (size_t i = 0; i < cmds.size(); i++) {
+        const DrawCommand& cmd = cmds[i];
+        if (cmd.IsEmpty()) continue;
+
+        if (cmd.instCount > 0 || cmd.texture) {
+            runs.push_back({ (UINT)i, cmd.idxOffset, cmd.elemCount, IsOpaque(list, cmd) });
+            continue;
+        }
+
+        // flat and textured triangles of the default texture, in runs
+        const Vertex* vtx = list.vtxBuffer.data() + cmd.vtxOffset;
+        const DrawIndex* idx = list.idxBuffer.data() + cmd.idxOffset;
+        for (UINT t = 0; t + 2 < cmd.elemCount; t += 3) {
+            bool solid = IsOpaqueVertex(vtx[idx[t]]) && IsOpaqueVertex(vtx[idx[t + 1]]) && IsOpaqueVertex(vtx[idx[t + 2]]);
+            if (t > 0 && runs.back().opaque == solid)
+                runs.back().elemCount += 3;
+            else
+                runs.push_back({ (UINT)i, cmd.idxOffset + t, 3, solid });
+        }
+    }
+
+    // evenly spaced, in double so neighbours stay apart as floats
+    double step = 1.0 / ((double)runs.size() + 1.0);
+    for (size_t r = 0; r < runs.size(); r++) {
+        const Run& run = runs[r];
+        DepthRun out = { run.command, run.idxOffset, run.elemCount, (float)(1.0 - (double)(r + 1) * step) };
+
+        const DrawCommand& cmd = cmds[run.command];
+        uint64_t triangles = cmd.instCount > 0 ? (uint64_t)cmd.instCount * (cmd.instVertexCount / 3) : run.elemCount / 3;
+        if (run.opaque) {
+            opaque.push_back(out);
+            stats.opaqueRuns++;
+            stats.opaqueTriangles += triangles;
+        }
+        else {
+            translucent.push_back(out);
+            stats.translucentRuns++;
+            stats.translucentTriangles += triangles;
+        }
+    }
+
+    std::reverse(opaque.begin(), opaque.end());
+}
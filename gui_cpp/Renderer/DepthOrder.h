@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+#include "DrawList.h"
+
+struct DepthOrderStats {
+    uint64_t opaqueRuns = 0;
+    uint64_t translucentRuns = 0;
+    uint64_t opaqueTriangles = 0;       // instances count by their triangles
+    uint64_t translucentTriangles = 0;
+};
+
+// Part of a command drawn in one call: indices [idxOffset, idxOffset +
+// elemCount) of an indexed command, or all of an instanced one
+struct DepthRun {
+    UINT command;
+    UINT idxOffset;
+    UINT elemCount;
+    float depth;        // in (0, 1), the depth buffer clears to 1
+};
+
+// Draw order for a depth-assisted pass. Commands are cut into runs of
+// triangles that are all opaque or all not, and every run gets a depth from
+// its place in the list, later runs nearer, so a depth test reproduces
+// painter's order: what a run covers is hidden from everything before it.
+// Opaque runs are drawn first, front to back with depth writes, so pixels
+// hidden behind nearer opaque geometry are rejected before shading. The rest
+// follows in painter's order, tested but not writing depth.
+//
+// Opaque means flat and solid: rect instances, or triangles with the default
+// texture and every vertex at uv (0, 0), the white texel, all at alpha 255.
+// Text shares its command with flat geometry (both use the first atlas
+// page) but is cut out of it as its own run. Images and analytic shapes
+// (their edges blend) are never opaque. Pure CPU and deterministic, the
+// result depends on the list only.
+class DepthOrder {
+public:
+    void Build(const DrawList& list);
+
+    // opaque front to back, translucent back to front
+    const std::vector<DepthRun>& GetOpaque() const { return opaque; }
+    const std::vector<DepthRun>& GetTranslucent() const { return translucent; }
+    const DepthOrderStats& GetStats() const { return stats; }
+
+    // The command of a run narrowed to its indices
+    static DrawCommand Slice(const DrawList& list, const DepthRun& run);
+
+    static bool IsOpaque(const DrawList& list, const DrawCommand& cmd);
+
+private:
+    struct Run {
+        UINT command, idxOffset, elemCount;
+        bool opaque;
+    };
+
+    std::vector<Run> runs;
+    std::vector<DepthRun> opaque;
+    std::vector<DepthRun> translucent;
+    DepthOrderStats stats;
+};
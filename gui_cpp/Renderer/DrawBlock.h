@@ -0,0 +1,24 @@
+#pragma once
+#include "DrawList.h"
+
+// Geometry recorded once and replayed every frame, for static pieces like
+// grids, diagrams or map outlines. Recording runs the usual Add*/Path* calls
+// (Renderer::BeginBlock/EndBlock), replaying (Renderer::AddBlock) copies the
+// finished vertices, indices and instances into the frame under the current
+// transform, so nothing is tessellated again. Channels used while recording
+// are kept.
+class DrawBlock {
+public:
+    void Clear() { list.Clear(); bounds = list.ComputeBounds(); }
+
+    bool IsEmpty() const { return bounds.left > bounds.right; }
+    const Rect& GetBounds() const { return bounds; }        // untransformed
+    const DrawList& GetList() const { return list; }
+
+private:
+    friend class Renderer;
+
+    DrawList list;
+    Rect bounds = { 1.f, 1.f, 0.f, 0.f };    // inverted while empty
+    DrawList* resumeList = nullptr;     // where the recording thread drew before BeginBlock
+};
@@ -0,0 +1,322 @@
+#include "DrawList.h"
+#include "Hash.h"
+#include <limits>
+#include <cfloat>
+#include <algorithm>
+
+void DrawList::Clear()
+{
+    vtxBuffer.clear();
+    idxBuffer.clear();
+    cmdBuffer.clear();
+    instBuffer.clear();
+    shapeBuffer.clear();
+    path.clear();
+    currentTexture = nullptr;
+    currentClip = UnboundedClipRect;
+    clipStack.clear();
+    currentTransform = DrawTransform();
+    transformStack.clear();
+    for (ChannelBuffers& channel : channels) channel.Clear();
+    currentChannel = DefaultChannel;
+    vtxCurrentIdx = 0;
+    vtxWritePtr = nullptr;
+    idxWritePtr = nullptr;
+}
+
+bool DrawList::IsEmpty() const
+{
+    if (!idxBuffer.empty() || !instBuffer.empty() || !shapeBuffer.empty()) return false;
+    for (const ChannelBuffers& channel : channels)
+        if (!channel.IsEmpty()) return false;
+    return true;
+}
+
+void DrawList::PrepareCommand(size_t vtxCount, UINT instVertexCount, bool shapes)
+{
+    constexpr size_t maxVertices = (size_t)std::numeric_limits<DrawIndex>::max() + 1;
+
+    bool newCommand = cmdBuffer.empty()
+        || cmdBuffer.back().texture != currentTexture
+        || cmdBuffer.back().clipRect != currentClip
+        || (cmdBuffer.back().instVertexCount == 0) != (instVertexCount == 0)
+        || cmdBuffer.back().shapeInstances != shapes
+        || vtxBuffer.size() - cmdBuffer.back().vtxOffset + vtxCount > maxVertices;
+
+    if (newCommand) {
+        DrawCommand cmd;
+        cmd.vtxOffset = (UINT)vtxBuffer.size();
+        cmd.idxOffset = (UINT)idxBuffer.size();
+        cmd.texture = currentTexture;
+        cmd.clipRect = currentClip;
+        cmd.instOffset = (UINT)(shapes ? shapeBuffer.size() : instBuffer.size());
+        cmd.instVertexCount = instVertexCount;
+        cmd.shapeInstances = shapes;
+
+        // an empty command can simply be taken over
+        if (!cmdBuffer.empty() && cmdBuffer.back().IsEmpty())
+            cmdBuffer.back() = cmd;
+        else
+            cmdBuffer.push_back(cmd);
+    }
+}
+
+void DrawList::PushClipRect(const Rect& rect, bool intersectWithCurrent)
+{
+    clipStack.push_back(currentClip);
+    currentClip = intersectWithCurrent ? rect.Intersect(currentClip) : rect;
+}
+
+void DrawList::PopClipRect()
+{
+    if (clipStack.empty()) return;
+    currentClip = clipStack.back();
+    clipStack.pop_back();
+}
+
+void DrawList::AppendTransformed(const DrawList& other, const DrawTransform& transform)
+{
+    if (other.channels.empty()) {
+        AppendGeometry(other.vtxBuffer, other.idxBuffer, other.cmdBuffer, other.instBuffer, other.shapeBuffer, transform);
+        return;
+    }
+
+    int channel = currentChannel;
+    for (int i = 0; i < DrawChannelCount; i++) {
+        if (i == other.currentChannel) {
+            if (other.idxBuffer.empty() && other.instBuffer.empty() && other.shapeBuffer.empty()) continue;
+            SetChannel(i);
+            AppendGeometry(other.vtxBuffer, other.idxBuffer, other.cmdBuffer, other.instBuffer, other.shapeBuffer, transform);
+        }
+        else {
+            const ChannelBuffers& src = other.channels[i];
+            if (src.IsEmpty()) continue;
+            SetChannel(i);
+            AppendGeometry(src.vtxBuffer, src.idxBuffer, src.cmdBuffer, src.instBuffer, src.shapeBuffer, transform);
+        }
+    }
+    SetChannel(channel);
+}
+
+void DrawList::AppendGeometry(const VertexBuffer& vtx, const IndexBuffer& idx, const std::vector<DrawCommand>& cmds,
+    const std::vector<RectInstance>& inst, const std::vector<ShapeInstance>& shapes, const DrawTransform& transform)
+{
+    if (idx.empty() && inst.empty() && shapes.empty()) return;
+
+    UINT vtxBase = (UINT)vtxBuffer.size();
+    UINT idxBase = (UINT)idxBuffer.size();
+    bool identity = transform.IsIdentity();
+    float scale = transform.scale;
+
+    vtxBuffer.resize(vtxBase + vtx.size());
+    Vertex* dst = vtxBuffer.data() + vtxBase;
+    if (identity) {
+        std::copy(vtx.begin(), vtx.end(), dst);
+    }
+    else {
+        for (const Vertex& v : vtx) {
+            *dst = v;
+            dst->x = v.x * scale + transform.translate.x;
+            dst->y = v.y * scale + transform.translate.y;
+            dst++;
+        }
+    }
+
+    idxBuffer.resize(idxBase + idx.size());
+    std::copy(idx.begin(), idx.end(), idxBuffer.data() + idxBase);
+
+    UINT instBase = (UINT)instBuffer.size();
+    instBuffer.insert(instBuffer.end(), inst.begin(), inst.end());
+    if (!identity) {
+        for (size_t i = instBase; i < instBuffer.size(); i++) {
+            RectInstance& r = instBuffer[i];
+            r.x = r.x * scale + transform.translate.x;
+            r.y = r.y * scale + transform.translate.y;
+            r.w *= scale;
+            r.h *= scale;
+            r.radius *= scale;
+        }
+    }
+
+    UINT shapeBase = (UINT)shapeBuffer.size();
+    shapeBuffer.insert(shapeBuffer.end(), shapes.begin(), shapes.end());
+    if (!identity) {
+        for (size_t i = shapeBase; i < shapeBuffer.size(); i++) {
+            ShapeInstance& s = shapeBuffer[i];
+            s.x = s.x * scale + transform.translate.x;
+            s.y = s.y * scale + transform.translate.y;
+            s.w *= scale;
+            s.h *= scale;
+            s.radius *= scale;
+            s.thickness *= scale;
+        }
+    }
+
+    if (!cmdBuffer.empty() && cmdBuffer.back().IsEmpty())
+        cmdBuffer.pop_back();
+
+    for (const DrawCommand& src : cmds) {
+        if (src.IsEmpty()) continue;
+
+        DrawCommand cmd = src;
+        cmd.vtxOffset += vtxBase;
+        cmd.idxOffset += idxBase;
+        cmd.instOffset += cmd.shapeInstances ? shapeBase : instBase;
+        cmd.clipRect = transform.Apply(src.clipRect).Intersect(currentClip);
+        cmdBuffer.push_back(cmd);
+    }
+}
+
+void DrawList::PushTransform(const DrawTransform& transform)
+{
+    transformStack.push_back(currentTransform);
+    currentTransform = currentTransform.Combine(transform);
+}
+
+void DrawList::PopTransform()
+{
+    if (transformStack.empty()) return;
+    currentTransform = transformStack.back();
+    transformStack.pop_back();
+}
+
+Rect DrawList::ComputeBounds() const
+{
+    Rect bounds = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+    auto add = [&](float left, float top, float right, float bottom) {
+        bounds.left = std::min(bounds.left, left);
+        bounds.top = std::min(bounds.top, top);
+        bounds.right = std::max(bounds.right, right);
+        bounds.bottom = std::max(bounds.bottom, bottom);
+    };
+    auto addBuffers = [&](const VertexBuffer& vtx, const std::vector<RectInstance>& inst, const std::vector<ShapeInstance>& shapes) {
+        for (const Vertex& v : vtx) add(v.x, v.y, v.x, v.y);
+        for (const RectInstance& r : inst) add(r.x, r.y, r.x + r.w, r.y + r.h);
+        for (const ShapeInstance& s : shapes)
+            add(s.x - ShapeFringe, s.y - ShapeFringe, s.x + s.w + ShapeFringe, s.y + s.h + ShapeFringe);
+    };
+
+    addBuffers(vtxBuffer, instBuffer, shapeBuffer);
+    for (const ChannelBuffers& channel : channels)
+        addBuffers(channel.vtxBuffer, channel.instBuffer, channel.shapeBuffer);
+    return bounds;
+}
+
+uint64_t DrawList::ComputeHash() const
+{
+    uint64_t hash = HashSeed;
+    auto hashBuffers = [&](int channel, const VertexBuffer& vtx, const IndexBuffer& idx, const std::vector<DrawCommand>& cmds,
+        const std::vector<RectInstance>& inst, const std::vector<ShapeInstance>& shapes) {
+        if (idx.empty() && inst.empty() && shapes.empty()) return;
+        hash = HashValue(channel, hash);
+        hash = HashBuffer(vtx.data(), vtx.size() * sizeof(Vertex), hash);
+        hash = HashBuffer(idx.data(), idx.size() * sizeof(DrawIndex), hash);
+        hash = HashBuffer(inst.data(), inst.size() * sizeof(RectInstance), hash);
+        hash = HashBuffer(shapes.data(), shapes.size() * sizeof(ShapeInstance), hash);
+        // field by field, the padding of a command is not initialised
+        for (const DrawCommand& cmd : cmds) {
+            UINT counts[6] = { cmd.vtxOffset, cmd.idxOffset, cmd.elemCount, cmd.instOffset, cmd.instCount, cmd.instVertexCount };
+            hash = HashValue(counts, hash);
+            hash = HashValue(cmd.texture, hash);
+            hash = HashValue(cmd.clipRect, hash);
+            hash = HashValue(cmd.shapeInstances, hash);
+        }
+    };
+
+    if (channels.empty()) {
+        hashBuffers(currentChannel, vtxBuffer, idxBuffer, cmdBuffer, instBuffer, shapeBuffer);
+        return hash;
+    }
+    for (int i = 0; i < (int)channels.size(); i++) {
+        if (i == currentChannel)
+            hashBuffers(i, vtxBuffer, idxBuffer, cmdBuffer, instBuffer, shapeBuffer);
+        else
+            hashBuffers(i, channels[i].vtxBuffer, channels[i].idxBuffer, channels[i].cmdBuffer, channels[i].instBuffer, channels[i].shapeBuffer);
+    }
+    return hash;
+}
+
+void DrawList::SwapChannel(ChannelBuffers& channel)
+{
+    vtxBuffer.swap(channel.vtxBuffer);
+    idxBuffer.swap(channel.idxBuffer);
+    cmdBuffer.swap(channel.cmdBuffer);
+    instBuffer.swap(channel.instBuffer);
+    shapeBuffer.swap(channel.shapeBuffer);
+}
+
+void DrawList::SetChannel(int channel)
+{
+    channel = std::clamp(channel, 0, DrawChannelCount - 1);
+    if (channel == currentChannel) return;
+    if (channels.empty()) channels.resize(DrawChannelCount);
+
+    SwapChannel(channels[currentChannel]);
+    SwapChannel(channels[channel]);
+    currentChannel = channel;
+
+    // the write cursors pointed into the buffers just parked
+    vtxWritePtr = nullptr;
+    idxWritePtr = nullptr;
+}
+
+void DrawList::MergeChannels()
+{
+    if (channels.empty()) return;
+
+    // channels keep the clips they were recorded with
+    SetChannel(0);
+    Rect clip = currentClip;
+    currentClip = UnboundedClipRect;
+    for (int i = 1; i < DrawChannelCount; i++) {
+        ChannelBuffers& src = channels[i];
+        AppendGeometry(src.vtxBuffer, src.idxBuffer, src.cmdBuffer, src.instBuffer, src.shapeBuffer, DrawTransform());
+        src.Clear();
+    }
+    currentClip = clip;
+
+    // every slot is empty now, so the buffers can count as any channel
+    currentChannel = DefaultChannel;
+}
+
+void DrawList::AddRectInstance(const RectInstance& rect)
+{
+    UINT vertexCount = RectInstanceVertexCount(rect);
+    PrepareCommand(0, vertexCount);
+
+    DrawCommand& cmd = cmdBuffer.back();
+    cmd.instCount++;
+    cmd.instVertexCount = std::max(cmd.instVertexCount, vertexCount);
+    instBuffer.push_back(rect);
+}
+
+void DrawList::AddShapeInstance(const ShapeInstance& shape)
+{
+    PrepareCommand(0, ShapeVertices, true);
+    cmdBuffer.back().instCount++;
+    shapeBuffer.push_back(shape);
+}
+
+void DrawList::PrimReserve(size_t vtxCount, size_t idxCount)
+{
+    PrepareCommand(vtxCount);
+
+    DrawCommand& cmd = cmdBuffer.back();
+    vtxCurrentIdx = (DrawIndex)(vtxBuffer.size() - cmd.vtxOffset);
+    cmd.elemCount += (UINT)idxCount;
+
+    size_t vtxOld = vtxBuffer.size();
+    vtxBuffer.resize(vtxOld + vtxCount);
+    vtxWritePtr = vtxBuffer.data() + vtxOld;
+
+    size_t idxOld = idxBuffer.size();
+    idxBuffer.resize(idxOld + idxCount);
+    idxWritePtr = idxBuffer.data() + idxOld;
+}
+
+void DrawList::PrimUnreserve(size_t vtxCount, size_t idxCount)
+{
+    vtxBuffer.resize(vtxBuffer.size() - vtxCount);
+    idxBuffer.resize(idxBuffer.size() - idxCount);
+    cmdBuffer.back().elemCount -= (UINT)idxCount;
+}
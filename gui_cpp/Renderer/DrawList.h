@@ -0,0 +1,270 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "RendererPrimitives.h"
+#include "Tessellation.h"
+#include "RectInstance.h"
+#include "ShapeInstance.h"
+
+// Indices are 16-bit. A command never addresses more than 65536 vertices,
+// once that range is used up a new command is started with its own base vertex.
+typedef uint16_t DrawIndex;
+
+// std::allocator that default-initialises, so resize() on the vertex and index
+// buffers does not zero memory that PrimReserve callers overwrite anyway.
+template <typename T>
+struct NoInitAllocator : std::allocator<T> {
+    template <typename U> struct rebind { using other = NoInitAllocator<U>; };
+
+    NoInitAllocator() = default;
+    template <typename U> NoInitAllocator(const NoInitAllocator<U>&) noexcept {}
+
+    template <typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible<U>::value) { ::new((void*)p) U; }
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) { ::new((void*)p) U(std::forward<Args>(args)...); }
+};
+
+// Draw channels: geometry is drawn channel by channel, lowest first, in
+// whatever order it was recorded. Lists start in DefaultChannel, the
+// channels between it and PopupChannel are free for the app.
+constexpr int DrawChannelCount = 8;
+constexpr int BackgroundChannel = 0;
+constexpr int DefaultChannel = 1;
+constexpr int PopupChannel = DrawChannelCount - 2;
+constexpr int OverlayChannel = DrawChannelCount - 1;
+
+// Translation and uniform scale: p * scale + translate, scale positive
+struct DrawTransform {
+    Vec2 translate = { 0.f, 0.f };
+    float scale = 1.f;
+
+    Vec2 Apply(Vec2 p) const { return { p.x * scale + translate.x, p.y * scale + translate.y }; }
+    Rect Apply(const Rect& r) const {
+        return { r.left * scale + translate.x, r.top * scale + translate.y,
+                 r.right * scale + translate.x, r.bottom * scale + translate.y };
+    }
+    // inner first, then this
+    DrawTransform Combine(const DrawTransform& inner) const { return { Apply(inner.translate), scale * inner.scale }; }
+    bool IsIdentity() const { return scale == 1.f && translate.x == 0.f && translate.y == 0.f; }
+};
+
+// Clip used while nothing has been pushed, large enough to never cut anything
+constexpr Rect UnboundedClipRect = { -1e9f, -1e9f, 1e9f, 1e9f };
+
+struct DrawCommand {
+    UINT vtxOffset = 0;     // base vertex, added to every index of this command
+    UINT idxOffset = 0;     // first index in idxBuffer
+    UINT elemCount = 0;     // number of indices
+    ID3D11ShaderResourceView* texture = nullptr; // nullptr = flat colour
+    Rect clipRect = UnboundedClipRect;           // scissor, in pixels
+
+    // instanced commands draw instCount rects from instBuffer (or shapes
+    // from shapeBuffer) instead of indices, every one expanded to
+    // instVertexCount vertices (0 = indexed)
+    UINT instOffset = 0;
+    UINT instCount = 0;
+    UINT instVertexCount = 0;
+    bool shapeInstances = false;
+
+    bool IsEmpty() const { return elemCount == 0 && instCount == 0; }
+};
+
+// CPU side geometry for one frame: vertices, triangle indices and the draw
+// commands that slice them. Positions are in window pixels, the projection is
+// applied in the vertex shader. Nothing in here touches the device, so counts
+// can be checked without one.
+class DrawList {
+public:
+    DrawList() = default;
+
+    void Clear();
+
+    // Texture sampled by the following primitives. Changing it starts a new
+    // command, so keep primitives that share a texture together.
+    void SetTexture(ID3D11ShaderResourceView* texture) { currentTexture = texture; }
+    ID3D11ShaderResourceView* GetTexture() const { return currentTexture; }
+
+    // Scissor rectangle for the following primitives, by default intersected
+    // with the current one. Like the texture, a change starts a new command.
+    void PushClipRect(const Rect& rect, bool intersectWithCurrent = true);
+    void PopClipRect();
+    const Rect& GetClipRect() const { return currentClip; }
+
+    // false when bounds lie entirely outside the current clip, primitives
+    // check this before reserving anything
+    bool IsVisible(const Rect& bounds) const { return bounds.Overlaps(currentClip); }
+
+    // Reserves vtxCount vertices and idxCount indices and points the write
+    // cursors at them. Every reserved slot must be written (or handed back with
+    // PrimUnreserve) before the next reserve. vtxCount must not exceed 65536.
+    void PrimReserve(size_t vtxCount, size_t idxCount);
+    void PrimUnreserve(size_t vtxCount, size_t idxCount);
+
+    // Write helpers, no capacity checks. Triangles are not culled, so any
+    // winding is fine.
+    void PrimWriteVtx(float x, float y, uint16_t u, uint16_t v, uint32_t col) {
+        vtxWritePtr->x = x;
+        vtxWritePtr->y = y;
+        vtxWritePtr->u = u;
+        vtxWritePtr->v = v;
+        vtxWritePtr->col = col;
+        vtxWritePtr++;
+        vtxCurrentIdx++;
+    }
+    void PrimWriteIdx(DrawIndex idx) { *idxWritePtr++ = idx; }
+
+    // A filled rect as 24 bytes in the instance stream instead of 4 vertices
+    // and 6 indices. Rects of the same kind (sharp or rounded) in a row share
+    // one instanced command, anything else in between starts a new one.
+    void AddRectInstance(const RectInstance& rect);
+
+    // An analytic shape, one quad with its coverage worked out per pixel.
+    // Consecutive shapes share one instanced command like rects do.
+    void AddShapeInstance(const ShapeInstance& shape);
+
+    // Copies another list's geometry to the end of this one, moved by offset.
+    // Its commands keep their own base vertex, so no index is rewritten, and
+    // their clip rects are intersected with the current clip. A list that
+    // used channels lands channel by channel in the same channels here, one
+    // that never did in the current channel.
+    void Append(const DrawList& other, Vec2 offset) { AppendTransformed(other, { offset, 1.f }); }
+    void AppendTransformed(const DrawList& other, const DrawTransform& transform);
+
+    // Transform stack for replayed geometry, pushes compose with the current
+    // transform. Only read by callers of AppendTransformed (blocks), the
+    // primitives added directly ignore it.
+    void PushTransform(const DrawTransform& transform);
+    void PopTransform();
+    const DrawTransform& GetTransform() const { return currentTransform; }
+
+    // Bounds of everything in the list, all channels, unclipped
+    Rect ComputeBounds() const;
+
+    // Hash of everything in the list, all channels: buffers, commands and
+    // the channel each lives in. Same geometry, same hash.
+    uint64_t ComputeHash() const;
+
+    // Switches the channel the following primitives go into. The buffers of
+    // the other channels are parked by swapping, not copied, so switching is
+    // cheap. Texture and clip stack are shared by all channels.
+    void SetChannel(int channel);
+    int GetChannel() const { return currentChannel; }
+
+    // Concatenates the channels in index order, one copy per channel and
+    // buffer, and leaves everything in DefaultChannel. Draw order of the
+    // buffers is only right after this.
+    void MergeChannels();
+
+    // 4 vertices, 6 indices
+    void PrimQuad(Vec2 a, Vec2 b, Vec2 c, Vec2 d, uint32_t col);
+    void PrimRect(Vec2 min, Vec2 max, uint32_t col);
+    void PrimRectUV(Vec2 min, Vec2 max, Vec2 uvMin, Vec2 uvMax, uint32_t col);
+
+    // no geometry in any channel
+    bool IsEmpty() const;
+
+    size_t GetVertexCount() const { return vtxBuffer.size(); }
+    size_t GetIndexCount() const { return idxBuffer.size(); }
+    size_t GetCommandCount() const { return cmdBuffer.size(); }
+    size_t GetInstanceCount() const { return instBuffer.size(); }
+    size_t GetShapeCount() const { return shapeBuffer.size(); }
+
+public:
+    std::vector<Vertex, NoInitAllocator<Vertex>> vtxBuffer;
+    std::vector<DrawIndex, NoInitAllocator<DrawIndex>> idxBuffer;
+    std::vector<DrawCommand> cmdBuffer;
+    std::vector<RectInstance> instBuffer;
+    std::vector<ShapeInstance> shapeBuffer;
+
+    // scratch points for the Path* calls, capacity kept across frames
+    std::vector<Vec2> path;
+    // scratch for stroking
+    std::vector<Vec2> tempPoints;
+    std::vector<Vec2> tempNormals;
+    Triangulator triangulator;
+
+    // write cursors, valid between PrimReserve and the next reserve
+    DrawIndex vtxCurrentIdx = 0;        // index the next written vertex gets
+    Vertex* vtxWritePtr = nullptr;
+    DrawIndex* idxWritePtr = nullptr;
+
+private:
+    using VertexBuffer = std::vector<Vertex, NoInitAllocator<Vertex>>;
+    using IndexBuffer = std::vector<DrawIndex, NoInitAllocator<DrawIndex>>;
+
+    // buffers of a channel that is not the current one
+    struct ChannelBuffers {
+        VertexBuffer vtxBuffer;
+        IndexBuffer idxBuffer;
+        std::vector<DrawCommand> cmdBuffer;
+        std::vector<RectInstance> instBuffer;
+        std::vector<ShapeInstance> shapeBuffer;
+
+        bool IsEmpty() const { return idxBuffer.empty() && instBuffer.empty() && shapeBuffer.empty(); }
+        void Clear() {
+            vtxBuffer.clear();
+            idxBuffer.clear();
+            cmdBuffer.clear();
+            instBuffer.clear();
+            shapeBuffer.clear();
+        }
+    };
+
+    void SwapChannel(ChannelBuffers& channel);
+    void AppendGeometry(const VertexBuffer& vtx, const IndexBuffer& idx, const std::vector<DrawCommand>& cmds,
+        const std::vector<RectInstance>& inst, const std::vector<ShapeInstance>& shapes, const DrawTransform& transform);
+
+    // picks the command the next vtxCount vertices (or instances of
+    // instVertexCount vertices each) go into
+    void PrepareCommand(size_t vtxCount, UINT instVertexCount = 0, bool shapes = false);
+
+    ID3D11ShaderResourceView* currentTexture = nullptr;
+    Rect currentClip = UnboundedClipRect;
+    std::vector<Rect> clipStack;
+    DrawTransform currentTransform;
+    std::vector<DrawTransform> transformStack;
+
+    // empty until the first SetChannel, the slot of the current channel is
+    // always empty while its buffers are the ones above
+    std::vector<ChannelBuffers> channels;
+    int currentChannel = DefaultChannel;
+};
+
+inline void DrawList::PrimQuad(Vec2 a, Vec2 b, Vec2 c, Vec2 d, uint32_t col)
+{
+    DrawIndex idx = vtxCurrentIdx;
+    idxWritePtr[0] = idx; idxWritePtr[1] = idx + 1; idxWritePtr[2] = idx + 2;
+    idxWritePtr[3] = idx + 2; idxWritePtr[4] = idx + 3; idxWritePtr[5] = idx;
+    idxWritePtr += 6;
+
+    PrimWriteVtx(a.x, a.y, 0, 0, col);
+    PrimWriteVtx(b.x, b.y, 0, 0, col);
+    PrimWriteVtx(c.x, c.y, 0, 0, col);
+    PrimWriteVtx(d.x, d.y, 0, 0, col);
+}
+
+inline void DrawList::PrimRect(Vec2 min, Vec2 max, uint32_t col)
+{
+    PrimQuad(min, { max.x, min.y }, max, { min.x, max.y }, col);
+}
+
+inline void DrawList::PrimRectUV(Vec2 min, Vec2 max, Vec2 uvMin, Vec2 uvMax, uint32_t col)
+{
+    uint16_t u0 = PackUnorm16(uvMin.x), v0 = PackUnorm16(uvMin.y);
+    uint16_t u1 = PackUnorm16(uvMax.x), v1 = PackUnorm16(uvMax.y);
+
+    DrawIndex idx = vtxCurrentIdx;
+    idxWritePtr[0] = idx; idxWritePtr[1] = idx + 1; idxWritePtr[2] = idx + 2;
+    idxWritePtr[3] = idx + 2; idxWritePtr[4] = idx + 3; idxWritePtr[5] = idx;
+    idxWritePtr += 6;
+
+    PrimWriteVtx(min.x, min.y, u0, v0, col);
+    PrimWriteVtx(max.x, min.y, u1, v0, col);
+    PrimWriteVtx(max.x, max.y, u1, v1, col);
+    PrimWriteVtx(min.x, max.y, u0, v1, col);
+}
@@ -0,0 +1,187 @@
+#include "DynamicTexture.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+DynamicTexture::DynamicTexture(IStagingDevice* dev, int w, int h)
+    : device(dev), width(std::max(w, 1)), height(std::max(h, 1))
+{
+    // created here rather than on first flush so the view can be drawn with
+    // straight away, the first flush uploads the cleared image
+    created = device->Create(width, height, StagingSlots);
+    if (!created) std::cerr << "Failed to create dynamic texture\n";
+
+    image.assign((size_t)width * height, 0);
+    dirtyRight = width;
+    dirtyBottom = height;
+}
+
+bool DynamicTexture::MarkDirty(int& x, int& y, int& w, int& h)
+{
+    int left = std::max(x, 0), top = std::max(y, 0);
+    int right = std::min(x + w, width), bottom = std::min(y + h, height);
+    if (right <= left || bottom <= top) return false;
+    x = left;
+    y = top;
+    w = right - left;
+    h = bottom - top;
+
+    if (dirtyRight <= dirtyLeft) {
+        dirtyLeft = left;
+        dirtyTop = top;
+        dirtyRight = right;
+        dirtyBottom = bottom;
+    }
+    else {
+        dirtyLeft = std::min(dirtyLeft, left);
+        dirtyTop = std::min(dirtyTop, top);
+        dirtyRight = std::max(dirtyRight, right);
+        dirtyBottom = std::max(dirtyBottom, bottom);
+    }
+    return true;
+}
+
+void DynamicTexture::Update(const uint32_t* pixels, int pitch, int x, int y, int w, int h)
+{
+    if (!pixels) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!MarkDirty(x, y, w, h)) return;
+
+    for (int row = y; row < y + h; row++)
+        memcpy(&image[(size_t)row * width + x], pixels + (size_t)row * pitch + x, w * sizeof(uint32_t));
+    stats.bytesCopied += (uint64_t)w * h * sizeof(uint32_t);
+}
+
+std::vector<uint32_t> DynamicTexture::Update(std::vector<uint32_t>&& newImage, int x, int y, int w, int h)
+{
+    if (newImage.size() != (size_t)width * height) return std::move(newImage);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    image.swap(newImage);
+    MarkDirty(x, y, w, h);
+    return std::move(newImage);
+}
+
+bool DynamicTexture::Flush()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (dirtyRight <= dirtyLeft) return false;
+
+    if (!created) {
+        dirtyLeft = dirtyTop = dirtyRight = dirtyBottom = 0;
+        return false;
+    }
+
+    int w = dirtyRight - dirtyLeft;
+    int h = dirtyBottom - dirtyTop;
+
+    // walk the ring from the copy used longest ago
+    for (int attempt = 0; attempt < StagingSlots; attempt++) {
+        int slot = nextSlot;
+        nextSlot = (nextSlot + 1) % StagingSlots;
+
+        size_t rowPitch = 0;
+        uint8_t* dst = (uint8_t*)device->MapStaging(slot, rowPitch);
+        if (!dst) {
+            stats.busySlots++;
+            continue;
+        }
+
+        for (int row = dirtyTop; row < dirtyBottom; row++)
+            memcpy(dst + row * rowPitch + dirtyLeft * sizeof(uint32_t), &image[(size_t)row * width + dirtyLeft], w * sizeof(uint32_t));
+        device->UnmapStaging(slot);
+        device->CopyStaging(slot, dirtyLeft, dirtyTop, w, h);
+
+        stats.uploads++;
+        stats.rowsStaged += h;
+        stats.bytesStaged += (uint64_t)w * h * sizeof(uint32_t);
+        dirtyLeft = dirtyTop = dirtyRight = dirtyBottom = 0;
+        return true;
+    }
+
+    stats.deferred++;
+    return false;
+}
+
+bool DynamicTexture::IsDirty() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return dirtyRight > dirtyLeft;
+}
+
+DynamicTextureStats DynamicTexture::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+D3D11StagingDevice::D3D11StagingDevice(ID3D11Device* dev, ID3D11DeviceContext* ctx)
+    : device(dev), context(ctx)
+{
+}
+
+D3D11StagingDevice::~D3D11StagingDevice()
+{
+    Release();
+}
+
+void D3D11StagingDevice::Release()
+{
+    for (ID3D11Texture2D* copy : staging) copy->Release();
+    staging.clear();
+    if (view) { view->Release(); view = nullptr; }
+    if (texture) { texture->Release(); texture = nullptr; }
+}
+
+bool D3D11StagingDevice::Create(int width, int height, int stagingCount)
+{
+    Release();
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = (UINT)width;
+    desc.Height = (UINT)height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    HRESULT hr = device->CreateTexture2D(&desc, nullptr, &texture);
+    if (FAILED(hr)) return false;
+    hr = device->CreateShaderResourceView(texture, nullptr, &view);
+    if (FAILED(hr)) return false;
+
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.BindFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    for (int i = 0; i < stagingCount; i++) {
+        ID3D11Texture2D* copy = nullptr;
+        hr = device->CreateTexture2D(&desc, nullptr, &copy);
+        if (FAILED(hr)) return false;
+        staging.push_back(copy);
+    }
+    return true;
+}
+
+void* D3D11StagingDevice::MapStaging(int slot, size_t& rowPitch)
+{
+    // DO_NOT_WAIT fails with WAS_STILL_DRAWING instead of stalling on a copy in flight
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    HRESULT hr = context->Map(staging[slot], 0, D3D11_MAP_WRITE, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+    if (FAILED(hr)) return nullptr;
+    rowPitch = mapped.RowPitch;
+    return mapped.pData;
+}
+
+void D3D11StagingDevice::UnmapStaging(int slot)
+{
+    context->Unmap(staging[slot], 0);
+}
+
+void D3D11StagingDevice::CopyStaging(int slot, int x, int y, int w, int h)
+{
+    D3D11_BOX box = { (UINT)x, (UINT)y, 0, (UINT)(x + w), (UINT)(y + h), 1 };
+    context->CopySubresourceRegion(texture, 0, (UINT)x, (UINT)y, 0, staging[slot], 0, &box);
+}
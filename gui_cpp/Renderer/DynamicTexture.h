@@ -0,0 +1,110 @@
+#pragma once
+#include <d3d11.h>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+// Device side of a dynamic texture: the texture that is sampled plus a ring
+// of staging copies the CPU writes into. Behind an interface like
+// IUploadDevice, so staging and dirty tracking can run on a fake device.
+class IStagingDevice {
+public:
+    virtual ~IStagingDevice() = default;
+
+    // Creates the RGBA8 texture and stagingCount staging copies of it
+    virtual bool Create(int width, int height, int stagingCount) = 0;
+    // Maps a staging copy for writing without waiting, nullptr while the GPU
+    // is still copying out of it
+    virtual void* MapStaging(int slot, size_t& rowPitch) = 0;
+    virtual void UnmapStaging(int slot) = 0;
+    // Copies a block of a staging copy to the same place in the texture
+    virtual void CopyStaging(int slot, int x, int y, int w, int h) = 0;
+    virtual ID3D11ShaderResourceView* GetView() const = 0;
+};
+
+struct DynamicTextureStats {
+    uint64_t uploads = 0;           // flushes that copied something to the texture
+    uint64_t rowsStaged = 0;
+    uint64_t bytesStaged = 0;       // bytes written into staging copies
+    uint64_t bytesCopied = 0;       // bytes Update copied from caller buffers
+    uint64_t busySlots = 0;         // staging copies passed over because the GPU still used them
+    uint64_t deferred = 0;          // flushes put off because every staging copy was busy
+};
+
+// Texture whose contents the CPU rewrites, e.g. video frames or heatmaps.
+//
+// The full image is kept on the CPU together with a dirty rectangle (the
+// bounding box of everything updated since the last flush). Flush() writes
+// only the dirty rows, and only the dirty columns of them, into the next
+// staging copy of a small ring and copies that block into the texture. A
+// staging copy the GPU is still reading is skipped rather than waited on,
+// if all are busy the upload moves to the next flush.
+//
+// Update() may be called from any thread, Flush() only from the thread that
+// owns the device context.
+class DynamicTexture {
+public:
+    static constexpr int StagingSlots = 3;
+
+    DynamicTexture(IStagingDevice* device, int width, int height);
+
+    // Copies the w x h block at x, y of an image the size of the texture,
+    // pitch in pixels
+    void Update(const uint32_t* pixels, int pitch, int x, int y, int w, int h);
+
+    // Takes a whole width * height image over instead of copying it, x, y, w,
+    // h is what changed since the previous image. Returns the buffer it
+    // replaces, holding the previous image, so callers can alternate between
+    // two buffers without allocating. A buffer of the wrong size is handed
+    // straight back.
+    std::vector<uint32_t> Update(std::vector<uint32_t>&& image, int x, int y, int w, int h);
+
+    // Stages and copies the dirty block, true if the texture changed
+    bool Flush();
+
+    bool IsDirty() const;
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    ID3D11ShaderResourceView* GetView() const { return device->GetView(); }
+    DynamicTextureStats GetStats() const;
+
+    // CPU copy of the image, for checking updates without a device
+    const std::vector<uint32_t>& GetImage() const { return image; }
+
+private:
+    // clips the block to the texture and adds it to the dirty rect, false if empty
+    bool MarkDirty(int& x, int& y, int& w, int& h);
+
+    IStagingDevice* device;
+    int width;
+    int height;
+    bool created = false;
+    int nextSlot = 0;
+
+    mutable std::mutex mutex;
+    std::vector<uint32_t> image;
+    int dirtyLeft = 0, dirtyTop = 0, dirtyRight = 0, dirtyBottom = 0;  // empty when right <= left
+    DynamicTextureStats stats;
+};
+
+class D3D11StagingDevice : public IStagingDevice {
+public:
+    D3D11StagingDevice(ID3D11Device* device, ID3D11DeviceContext* context);
+    ~D3D11StagingDevice();
+
+    bool Create(int width, int height, int stagingCount) override;
+    void* MapStaging(int slot, size_t& rowPitch) override;
+    void UnmapStaging(int slot) override;
+    void CopyStaging(int slot, int x, int y, int w, int h) override;
+    ID3D11ShaderResourceView* GetView() const override { return view; }
+
+private:
+    void Release();
+
+    ID3D11Device* device;
+    ID3D11DeviceContext* context;
+    ID3D11Texture2D* texture = nullptr;
+    ID3D11ShaderResourceView* view = nullptr;
+    std::vector<ID3D11Texture2D*> staging;
+};
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <cstring>
+#include <type_traits>
+
+// 64-bit FNV-1a, used to fingerprint UI state between frames
+constexpr uint64_t HashSeed = 14695981039346656037ull;
+
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = HashSeed)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Word-at-a-time mix for large buffers such as vertex data. Not FNV, only
+// meant to be compared with itself.
+inline uint64_t HashBuffer(const void* data, size_t size, uint64_t hash = HashSeed)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t w;
+        memcpy(&w, bytes + i * 8, 8);
+        hash = (hash ^ w) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    }
+    return HashBytes(bytes + words * 8, size - words * 8, hash);
+}
+
+template <typename T>
+inline uint64_t HashValue(const T& value, uint64_t hash = HashSeed)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "hash plain values only");
+    return HashBytes(&value, sizeof(T), hash);
+}
+
+inline uint64_t HashString(const std::string& s, uint64_t hash = HashSeed)
+{
+    hash = HashValue(s.size(), hash);
+    return HashBytes(s.data(), s.size(), hash);
+}
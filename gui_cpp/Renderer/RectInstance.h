@@ -0,0 +1,97 @@
+#pragma once
+#include <d3d11.h>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "RendererPrimitives.h"
+
+// One filled rectangle of the instance stream, expanded into triangles by the
+// instanced vertex shader. x, y is the top-left corner, w and h are positive
+// and radius is already clamped to half the smaller side (0 = sharp).
+struct RectInstance {
+    float x, y, w, h;
+    uint32_t col;       // packed RGBA8
+    float radius;
+};
+static_assert(sizeof(RectInstance) == 24, "RectInstance layout must match the instance input layout");
+
+// Rounded corners always get this many segments, every instance of a draw
+// has to expand to the same number of vertices
+constexpr int RectCornerSegments = 6;
+constexpr int RectOutlinePoints = 4 * (RectCornerSegments + 1);
+constexpr UINT SharpRectVertices = 6;
+constexpr UINT RoundedRectVertices = 3 * (RectOutlinePoints - 2);
+
+inline UINT RectInstanceVertexCount(const RectInstance& r)
+{
+    return r.radius > 0.f ? RoundedRectVertices : SharpRectVertices;
+}
+
+// Direction from the corner centre to each outline point, clockwise on screen
+// from the top-left corner. The vertex shader gets the same values as a
+// literal table, so both expansions compute identical positions.
+inline const Vec2* RectCornerTable()
+{
+    static const std::array<Vec2, RectOutlinePoints> table = [] {
+        std::array<Vec2, RectOutlinePoints> t{};
+        const double halfPi = 1.57079632679489661923;
+        for (int i = 0; i < RectOutlinePoints; i++) {
+            int corner = i / (RectCornerSegments + 1);
+            int step = i % (RectCornerSegments + 1);
+            double a = 2.0 * halfPi + corner * halfPi + step * halfPi / RectCornerSegments;
+            t[i] = { (float)std::cos(a), (float)std::sin(a) };
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+// The corner table as the HLSL the instanced vertex shader is compiled with,
+// nine significant digits so every float reads back bit-identical
+inline std::string RectCornerTableHlsl()
+{
+    std::string table = "static const float2 cornerDir[" + std::to_string(RectOutlinePoints) + "] = { ";
+    const Vec2* corners = RectCornerTable();
+    for (int i = 0; i < RectOutlinePoints; i++) {
+        char entry[64];
+        snprintf(entry, sizeof(entry), "%sfloat2(%.9g, %.9g)", i ? ", " : "", corners[i].x, corners[i].y);
+        table += entry;
+    }
+    return table + " };\n";
+}
+
+// Point i of the rounded outline
+inline Vec2 RectOutlinePoint(const RectInstance& r, int i)
+{
+    int corner = i / (RectCornerSegments + 1);
+    float cx = (corner == 0 || corner == 3) ? r.x + r.radius : (r.x + r.w) - r.radius;
+    float cy = corner < 2 ? r.y + r.radius : (r.y + r.h) - r.radius;
+    const Vec2& d = RectCornerTable()[i];
+    return { cx + d.x * r.radius, cy + d.y * r.radius };
+}
+
+// Position of vertex vertexId, like SV_VertexID in the instanced vertex
+// shader. Sharp rects are the two triangles of DrawList::PrimRect, rounded
+// ones a fan over the outline. A command draws every instance with the
+// largest vertex count among them, sharp rects in a rounded batch pad theirs
+// out with degenerate triangles.
+inline Vec2 RectInstanceVertex(const RectInstance& r, int vertexId)
+{
+    if (r.radius <= 0.f) {
+        // batched with rounded rects: the extra vertices collapse to a point
+        if (vertexId >= (int)SharpRectVertices) return { r.x, r.y };
+
+        static const int quadIndex[6] = { 0, 1, 2, 2, 3, 0 };
+        int corner = quadIndex[vertexId];
+        float x = (corner == 1 || corner == 2) ? r.x + r.w : r.x;
+        float y = corner >= 2 ? r.y + r.h : r.y;
+        return { x, y };
+    }
+
+    int triangle = vertexId / 3;
+    int k = vertexId % 3;
+    return RectOutlinePoint(r, k == 0 ? 0 : triangle + k);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+#include "DrawList.h"
+#include "DepthOrder.h"
+
+// Consumes finished frames. The renderer's D3D11 path is one implementation,
+// SoftwareBackend another; either can be driven from the render thread.
+class RenderBackend {
+public:
+    virtual ~RenderBackend() = default;
+
+    // Draws the list into a width x height target
+    virtual void RenderFrame(const DrawList& list, int width, int height) = 0;
+
+    // Shows the last rendered frame
+    virtual void Present() {}
+
+    // Called on the submitting thread right before a frame is handed over,
+    // while no frame renders: copy any state the app thread may change
+    virtual void CaptureFrameState() {}
+};
+
+// CPU rasteriser standing in for the GPU, so frame submission and the render
+// thread can be run and checked without a device. Flat colour only: textures
+// are not sampled, textured triangles come out in their vertex colour.
+// Honours clip rects and blends source over destination like the GPU path.
+class SoftwareBackend : public RenderBackend {
+public:
+    void SetClearColor(uint32_t rgba8) { clearColor = rgba8; }
+    // draw with the depth-assisted order of Renderer::SetDepthPass
+    void SetDepthPass(bool enabled) { depthPass = enabled; }
+
+    void RenderFrame(const DrawList& list, int width, int height) override;
+    void Present() override { presentCount++; }
+
+    // RGBA8 pixels of the last frame, r in the low byte like the vertex colours
+    const std::vector<uint32_t>& GetPixels() const { return pixels; }
+    int GetWidth() const { return targetWidth; }
+    int GetHeight() const { return targetHeight; }
+    uint64_t GetFrameCount() const { return frameCount; }
+    uint64_t GetPresentCount() const { return presentCount; }
+
+    // Pixels of the last frame that were blended, and with the depth pass
+    // the ones the depth test rejected, i.e. the overdraw it avoided
+    uint64_t GetPixelsShaded() const { return pixelsShaded; }
+    uint64_t GetPixelsRejected() const { return pixelsRejected; }
+    const DepthOrderStats& GetDepthOrderStats() const { return depthOrder.GetStats(); }
+
+private:
+    void FillTriangle(const Vertex& a, const Vertex& b, const Vertex& c, int clipLeft, int clipTop, int clipRight, int clipBottom);
+    void FillShape(const ShapeInstance& shape, int clipLeft, int clipTop, int clipRight, int clipBottom);
+    void DrawCommandPixels(const DrawList& list, const DrawCommand& cmd);
+    bool DepthTest(size_t index);
+
+    std::vector<uint32_t> pixels;
+    int targetWidth = 0;
+    int targetHeight = 0;
+    uint32_t clearColor = 0xff000000;
+    uint64_t frameCount = 0;
+    uint64_t presentCount = 0;
+
+    enum class DepthMode { Off, Write, Test };
+    bool depthPass = false;
+    DepthMode depthMode = DepthMode::Off;
+    float commandDepth = 0.f;
+    std::vector<float> depth;
+    DepthOrder depthOrder;
+    uint64_t pixelsShaded = 0;
+    uint64_t pixelsRejected = 0;
+};
@@ -0,0 +1,59 @@
+#include "RenderThread.h"
+#include <utility>
+
+RenderThread::RenderThread(RenderBackend* b)
+    : backend(b)
+{
+    thread = std::thread(&RenderThread::Loop, this);
+}
+
+RenderThread::~RenderThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+void RenderThread::Submit(DrawList& list, int width, int height)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [this] { return !pending && !busy; });
+
+    backend->CaptureFrameState();
+    std::swap(frame, list);
+    frameWidth = width;
+    frameHeight = height;
+    pending = true;
+    lock.unlock();
+    wake.notify_all();
+}
+
+void RenderThread::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [this] { return !pending && !busy; });
+}
+
+void RenderThread::Loop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return pending || quit; });
+        if (!pending) return;
+
+        pending = false;
+        busy = true;
+        lock.unlock();
+
+        backend->RenderFrame(frame, frameWidth, frameHeight);
+        backend->Present();
+
+        lock.lock();
+        busy = false;
+        framesRendered.fetch_add(1, std::memory_order_relaxed);
+        wake.notify_all();
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+#include "DrawList.h"
+#include "RenderBackend.h"
+
+// Submits frames to a backend from its own thread. The app thread builds
+// frame N+1 while frame N renders and presents here. There are exactly two
+// lists: the one the app thread fills and the one this thread reads, and
+// Submit() swaps them, so neither side ever touches the other's list.
+class RenderThread {
+public:
+    explicit RenderThread(RenderBackend* backend);
+    ~RenderThread();            // finishes the frame in flight, then joins
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    // Hands the finished frame over and gives back the list of the previous
+    // one for reuse. Blocks until that previous frame is fully rendered and
+    // presented, so the app is never more than one frame ahead. The backend
+    // captures its frame state here, with the render thread idle.
+    void Submit(DrawList& list, int width, int height);
+
+    // Returns once nothing is queued or rendering (e.g. before a resize)
+    void WaitIdle();
+
+    uint64_t GetFramesRendered() const { return framesRendered.load(std::memory_order_relaxed); }
+
+private:
+    void Loop();
+
+    RenderBackend* backend;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    DrawList frame;             // owned by this thread between Submit and the end of the render
+    int frameWidth = 0;
+    int frameHeight = 0;
+    bool pending = false;
+    bool busy = false;
+    bool quit = false;
+    std::atomic<uint64_t> framesRendered{ 0 };
+};
@@ -3,14 +3,36 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
 #include <d3dcompiler.h>
 #pragma comment(lib, "d3dcompiler.lib")
 
+thread_local Renderer::TargetList Renderer::threadTarget = { nullptr, nullptr };
+thread_local Renderer::ThreadListCache Renderer::threadListCache = { 0, nullptr };
+std::atomic<uint64_t> Renderer::nextInstanceId{ 0 };
+
+// Matches cbuffer Projection in the vertex shader
+struct ProjectionConstants {
+    float scale[2];
+    float translate[2];
+};
+
 Renderer::Renderer(ID3D11Device* dev, ID3D11DeviceContext* ctx)
     : device(dev), context(ctx)
 {
     ui = std::make_unique<Ui>(this);
 
+    atlasDevice = std::make_unique<D3D11AtlasDevice>(device, context);
+    atlas = std::make_unique<TextureAtlas>(atlasDevice.get());
+
+    // headless: text is still laid out, with glyphs from the font map alone
+    if (!device) {
+        LoadFontMap("font.fnt");
+        return;
+    }
+
     HRESULT hr = CreateWICTextureFromFile(device, context, L"font.png", nullptr, &fontTextureView);
     if (FAILED(hr)) {
         std::cerr << "Failed to load font texture\n";
@@ -32,65 +54,105 @@ Renderer::Renderer(ID3D11Device* dev, ID3D11DeviceContext* ctx)
 
         fontTex->Release();
         fontRes->Release();
+
+        // move the font page into the atlas so text batches with images and
+        // flat geometry, the separate texture stays only if that fails
+        std::vector<uint32_t> pixels;
+        int width = 0, height = 0;
+        ImageId fontImage = InvalidImage;
+        if (ReadTexturePixels(fontTextureView, pixels, width, height))
+            fontImage = atlas->Add(pixels.data(), width, height);
+
+        if (fontImage != InvalidImage) {
+            // glyph rects are in font texture pixels, map them into the region
+            AtlasRegion region = atlas->GetRegion(fontImage);
+            float du = (region.uvMax.x - region.uvMin.x) / region.width;
+            float dv = (region.uvMax.y - region.uvMin.y) / region.height;
+            for (auto& [id, fc] : fontMap) {
+                fc.u0 = region.uvMin.x + fc.x * du;
+                fc.v0 = region.uvMin.y + fc.y * dv;
+                fc.u1 = region.uvMin.x + (fc.x + fc.w) * du;
+                fc.v1 = region.uvMin.y + (fc.y + fc.h) * dv;
+            }
+            glyphTexture = PageTexture(region.page);
+            fontTextureView->Release();
+            fontTextureView = nullptr;
+        }
+        else {
+            glyphTexture = fontTextureView;
+        }
     }
 
     
 
+    // ClearView needs the 11.1 runtime, without it every frame is a full redraw
+    context->QueryInterface(&context1);
+
     InitPipeline();
 }
 
 Renderer::~Renderer() {
-    if (gpuVertexBuffer) gpuVertexBuffer->Release();
+    renderThread.reset();
+    if (context1) context1->Release();
+    if (projectionBuffer) projectionBuffer->Release();
+    if (rasterizerState) rasterizerState->Release();
+    if (whiteTextureView) whiteTextureView->Release();
+    if (fontTextureView) fontTextureView->Release();
     if (inputLayout) inputLayout->Release();
     if (vertexShader) vertexShader->Release();
     if (pixelShader) pixelShader->Release();
+    if (instanceInputLayout) instanceInputLayout->Release();
+    if (instanceVertexShader) instanceVertexShader->Release();
+    if (shapeInputLayout) shapeInputLayout->Release();
+    if (shapeVertexShader) shapeVertexShader->Release();
+    if (shapePixelShader) shapePixelShader->Release();
+    if (depthView) depthView->Release();
+    if (depthWriteState) depthWriteState->Release();
+    if (depthTestState) depthTestState->Release();
 }
 
 void Renderer::InitPipeline() {
     const char* vsSrc = R"(
+    // pixel space -> NDC, set once per frame
+    cbuffer Projection : register(b0) {
+        float2 scale;
+        float2 translate;
+    };
+
     struct VS_IN {
-        float3 pos : POSITION;
-        float4 color : COLOR;
+        float2 pos : POSITION;
         float2 uv : TEXCOORD0;
-        float texIndex : TEXCOORD1;
+        float4 color : COLOR;
     };
 
     struct PS_IN {
         float4 pos : SV_POSITION;
         float4 color : COLOR;
         float2 uv : TEXCOORD0;
-        float texIndex : TEXCOORD1;
     };
 
     PS_IN main(VS_IN input) {
         PS_IN o;
-        o.pos = float4(input.pos, 1.0f);
+        o.pos = float4(input.pos * scale + translate, 0.0f, 1.0f);
         o.color = input.color;
         o.uv = input.uv;
-        o.texIndex = input.texIndex;
         return o;
     }
     )";
 
     const char* psSrc = R"(
-    Texture2D fontTex : register(t0);
-    SamplerState fontSampler : register(s0);
+    Texture2D tex : register(t0);
+    SamplerState texSampler : register(s0);
 
     struct PS_IN {
         float4 pos : SV_POSITION;
         float4 color : COLOR;
         float2 uv : TEXCOORD0;
-        float texIndex : TEXCOORD1;
     };
 
     float4 main(PS_IN input) : SV_Target {
-        if (input.texIndex < 0.5f) {
-            // geometry (no texture)
-            return input.color;
-        } else {
-            float4 texc = fontTex.Sample(fontSampler, input.uv);
-            return texc * input.color;
-        }
+        // flat geometry is drawn with a 1x1 white texture bound
+        return tex.Sample(texSampler, input.uv) * input.color;
     }
     )";
 
@@ -116,10 +178,9 @@ void Renderer::InitPipeline() {
 
     // Input layout matching Vertex struct:
     D3D11_INPUT_ELEMENT_DESC layout[] = {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,   0, 0,                           D3D11_INPUT_PER_VERTEX_DATA, 0 },
-        { "COLOR",    0, DXGI_FORMAT_R32G32B32A32_FLOAT,0, 12,                          D3D11_INPUT_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,      0, 28,                          D3D11_INPUT_PER_VERTEX_DATA, 0 }, // uv -> TEXCOORD0
-        { "TEXCOORD", 1, DXGI_FORMAT_R32_FLOAT,         0, 36,                          D3D11_INPUT_PER_VERTEX_DATA, 0 }, // texIndex -> TEXCOORD1
+        { "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT,      0, 0,                           D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R16G16_UNORM,      0, 8,                           D3D11_INPUT_PER_VERTEX_DATA, 0 }, // unorm16 uv
+        { "COLOR",    0, DXGI_FORMAT_R8G8B8A8_UNORM,    0, 12,                          D3D11_INPUT_PER_VERTEX_DATA, 0 }, // packed RGBA8
     };
     UINT numElements = ARRAYSIZE(layout);
     hr = device->CreateInputLayout(layout, numElements, vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), &inputLayout);
@@ -128,15 +189,28 @@ void Renderer::InitPipeline() {
     vsBlob->Release();
     psBlob->Release();
 
-    // create initial dynamic gpu vertex buffer (size in vertices)
-    D3D11_BUFFER_DESC bd = {};
-    bd.Usage = D3D11_USAGE_DYNAMIC;
-    bd.ByteWidth = sizeof(Vertex) * 4096; // start capacity
-    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    hr = device->CreateBuffer(&bd, nullptr, &gpuVertexBuffer);
-    if (FAILED(hr)) std::cerr << "Failed to create dynamic vertex buffer\n";
-    gpuBufferCapacity = 4096;
+    // streaming vertex/index buffers, created on first upload (start capacity
+    // 4096 vertices, 6 indices per 4 vertices of a quad)
+    vertexStream = std::make_unique<D3D11UploadBuffer>(device, context, D3D11_BIND_VERTEX_BUFFER);
+    indexStream = std::make_unique<D3D11UploadBuffer>(device, context, D3D11_BIND_INDEX_BUFFER);
+    vertexUpload = std::make_unique<UploadAllocator>(vertexStream.get(), sizeof(Vertex) * 4096);
+    indexUpload = std::make_unique<UploadAllocator>(indexStream.get(), sizeof(DrawIndex) * 6144);
+    instanceStream = std::make_unique<D3D11UploadBuffer>(device, context, D3D11_BIND_VERTEX_BUFFER);
+    instanceUpload = std::make_unique<UploadAllocator>(instanceStream.get(), sizeof(RectInstance) * 1024);
+    shapeStream = std::make_unique<D3D11UploadBuffer>(device, context, D3D11_BIND_VERTEX_BUFFER);
+    shapeUpload = std::make_unique<UploadAllocator>(shapeStream.get(), sizeof(ShapeInstance) * 256);
+
+    InitInstancePipeline();
+    InitShapePipeline();
+
+    // projection constants, rewritten once per frame in FlushBatch
+    D3D11_BUFFER_DESC cbd = {};
+    cbd.Usage = D3D11_USAGE_DYNAMIC;
+    cbd.ByteWidth = sizeof(ProjectionConstants);
+    cbd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    cbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    hr = device->CreateBuffer(&cbd, nullptr, &projectionBuffer);
+    if (FAILED(hr)) std::cerr << "Failed to create projection constant buffer\n";
 
     // create blend state & sampler 
     D3D11_BLEND_DESC blend_desc = {};
@@ -156,238 +230,1532 @@ void Renderer::InitPipeline() {
     samp.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
     samp.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
     device->CreateSamplerState(&samp, &fontSampler);
+
+    // no culling: primitives can be written in any winding
+    D3D11_RASTERIZER_DESC rast = {};
+    rast.FillMode = D3D11_FILL_SOLID;
+    rast.CullMode = D3D11_CULL_NONE;
+    rast.DepthClipEnable = TRUE;
+    rast.ScissorEnable = TRUE;
+    device->CreateRasterizerState(&rast, &rasterizerState);
+
+    // depth pass: opaque commands test and write, the rest only test. Equal
+    // passes, so within a command later triangles still win.
+    D3D11_DEPTH_STENCIL_DESC depthDesc = {};
+    depthDesc.DepthEnable = TRUE;
+    depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+    depthDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+    device->CreateDepthStencilState(&depthDesc, &depthWriteState);
+    depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+    device->CreateDepthStencilState(&depthDesc, &depthTestState);
+
+    // 1x1 white texture bound for commands without a texture
+    const uint32_t whitePixel = 0xffffffff;
+    D3D11_TEXTURE2D_DESC texDesc = {};
+    texDesc.Width = 1;
+    texDesc.Height = 1;
+    texDesc.MipLevels = 1;
+    texDesc.ArraySize = 1;
+    texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    texDesc.SampleDesc.Count = 1;
+    texDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    D3D11_SUBRESOURCE_DATA texData = {};
+    texData.pSysMem = &whitePixel;
+    texData.SysMemPitch = sizeof(whitePixel);
+
+    ID3D11Texture2D* whiteTex = nullptr;
+    hr = device->CreateTexture2D(&texDesc, &texData, &whiteTex);
+    if (SUCCEEDED(hr)) {
+        hr = device->CreateShaderResourceView(whiteTex, nullptr, &whiteTextureView);
+        whiteTex->Release();
+    }
+    if (FAILED(hr)) std::cerr << "Failed to create white texture\n";
 }
 
-void Renderer::Begin() {
-    vertexCount = 0;
-    context->IASetInputLayout(inputLayout);
-    context->VSSetShader(vertexShader, nullptr, 0);
-    context->PSSetShader(pixelShader, nullptr, 0);
-    context->OMSetBlendState(alphaBlendState, nullptr, 0xffffffff);
-    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+// Vertex shader of the rect instance stream, the same expansion as
+// RectInstanceVertex. The corner table is pasted in from RectCornerTable so
+// both sides work with bit-identical directions.
+void Renderer::InitInstancePipeline()
+{
+    std::string src = RectCornerTableHlsl() +
+        "#define CORNER_POINTS " + std::to_string(RectCornerSegments + 1) + "\n";
+    src += R"(
+    cbuffer Projection : register(b0) {
+        float2 scale;
+        float2 translate;
+    };
 
+    static const uint quadIndex[6] = { 0, 1, 2, 2, 3, 0 };
 
-    //viewport
-    D3D11_VIEWPORT vp{};
-    vp.TopLeftX = 0;
-    vp.TopLeftY = 0;
-    vp.Width = static_cast<FLOAT>(windowWidth);
-    vp.Height = static_cast<FLOAT>(windowHeight);
-    vp.MinDepth = 0.f;
-    vp.MaxDepth = 1.f;
-    context->RSSetViewports(1, &vp);
+    struct VS_IN {
+        float4 rect : RECT;         // x, y, w, h
+        float4 color : COLOR;
+        float radius : RADIUS;
+        uint id : SV_VertexID;
+    };
 
-    //update mouse
-    ui->UpdateMouseAndKey(hwnd);
+    struct PS_IN {
+        float4 pos : SV_POSITION;
+        float4 color : COLOR;
+        float2 uv : TEXCOORD0;
+    };
+
+    PS_IN main(VS_IN input) {
+        float2 p;
+        if (input.id >= 6 && input.radius <= 0.0f) {
+            // a sharp rect batched with rounded ones, collapse to a point
+            p = input.rect.xy;
+        }
+        else if (input.radius <= 0.0f) {
+            // two triangles, like DrawList::PrimRect
+            uint corner = quadIndex[input.id];
+            p.x = (corner == 1 || corner == 2) ? input.rect.x + input.rect.z : input.rect.x;
+            p.y = corner >= 2 ? input.rect.y + input.rect.w : input.rect.y;
+        }
+        else {
+            // fan over the outline, triangle t is points 0, t + 1, t + 2
+            uint k = input.id % 3;
+            uint i = k == 0 ? 0 : input.id / 3 + k;
+            uint corner = i / CORNER_POINTS;
+            float r = input.radius;
+            float cx = (corner == 0 || corner == 3) ? input.rect.x + r : (input.rect.x + input.rect.z) - r;
+            float cy = corner < 2 ? input.rect.y + r : (input.rect.y + input.rect.w) - r;
+            p = float2(cx + cornerDir[i].x * r, cy + cornerDir[i].y * r);
+        }
+
+        PS_IN o;
+        o.pos = float4(p * scale + translate, 0.0f, 1.0f);
+        o.color = input.color;
+        o.uv = float2(0.0f, 0.0f);      // the white texel
+        return o;
+    }
+    )";
+
+    ID3DBlob* vsBlob = nullptr;
+    ID3DBlob* errorBlob = nullptr;
+    HRESULT hr = D3DCompile(src.c_str(), src.size(), nullptr, nullptr, nullptr, "main", "vs_5_0", 0, 0, &vsBlob, &errorBlob);
+    if (FAILED(hr)) {
+        if (errorBlob) { std::cerr << "[Instance VS] " << (char*)errorBlob->GetBufferPointer() << std::endl; errorBlob->Release(); }
+        return;
+    }
+
+    hr = device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &instanceVertexShader);
+    if (FAILED(hr)) std::cerr << "Failed to create instance vertex shader\n";
+
+    // Input layout matching RectInstance, one element per instance
+    D3D11_INPUT_ELEMENT_DESC layout[] = {
+        { "RECT",   0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "COLOR",  0, DXGI_FORMAT_R8G8B8A8_UNORM,     0, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "RADIUS", 0, DXGI_FORMAT_R32_FLOAT,          0, 20, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    };
+    hr = device->CreateInputLayout(layout, ARRAYSIZE(layout), vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), &instanceInputLayout);
+    if (FAILED(hr)) std::cerr << "Failed to create instance input layout\n";
+
+    vsBlob->Release();
 }
 
-void Renderer::AddTriangle(Vec2 a, Vec2 b, Vec2 c, const Color& color)
+// Shaders of the shape stream. The vertex shader spans the quad of
+// ShapeQuadVertex, the pixel shader is ShapeCoverage evaluated at the pixel
+// centre SV_Position gives, with the shape passed along unchanged.
+void Renderer::InitShapePipeline()
 {
-    if (windowWidth == 0 || windowHeight == 0) return;
+    std::string defines = "#define FRINGE " + std::to_string(ShapeFringe) + "\n";
+    std::string vsSrc = defines + R"(
+    cbuffer Projection : register(b0) {
+        float2 scale;
+        float2 translate;
+    };
 
-    
-    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    static const uint quadIndex[6] = { 0, 1, 2, 2, 3, 0 };
+
+    struct VS_IN {
+        float4 rect : RECT;         // x, y, w, h
+        float4 color : COLOR;
+        float2 shape : SHAPE;       // radius, thickness
+        uint id : SV_VertexID;
+    };
+
+    struct PS_IN {
+        float4 pos : SV_POSITION;
+        nointerpolation float4 rect : RECT;
+        nointerpolation float4 color : COLOR;
+        nointerpolation float2 shape : SHAPE;
+    };
+
+    PS_IN main(VS_IN input) {
+        uint corner = quadIndex[input.id];
+        float2 p;
+        p.x = (corner == 1 || corner == 2) ? input.rect.x + input.rect.z + FRINGE : input.rect.x - FRINGE;
+        p.y = corner >= 2 ? input.rect.y + input.rect.w + FRINGE : input.rect.y - FRINGE;
+
+        PS_IN o;
+        o.pos = float4(p * scale + translate, 0.0f, 1.0f);
+        o.rect = input.rect;
+        o.color = input.color;
+        o.shape = input.shape;
+        return o;
+    }
+    )";
+
+    const char* psSrc = R"(
+    struct PS_IN {
+        float4 pos : SV_POSITION;
+        nointerpolation float4 rect : RECT;
+        nointerpolation float4 color : COLOR;
+        nointerpolation float2 shape : SHAPE;
+    };
+
+    float4 main(PS_IN input) : SV_TARGET {
+        float2 halfSize = input.rect.zw * 0.5f;
+        float radius = input.shape.x;
+        float2 q = abs(input.pos.xy - (input.rect.xy + halfSize)) - halfSize + radius;
+        float d = length(max(q, 0.0f)) + min(max(q.x, q.y), 0.0f) - radius;
+        if (input.shape.y > 0.0f) d = max(d, -(d + input.shape.y));
+
+        float coverage = saturate(0.5f - d);
+        if (coverage <= 0.0f) discard;
+        return float4(input.color.rgb, input.color.a * coverage);
+    }
+    )";
+
+    ID3DBlob* vsBlob = nullptr;
+    ID3DBlob* psBlob = nullptr;
+    ID3DBlob* errorBlob = nullptr;
+    HRESULT hr = D3DCompile(vsSrc.c_str(), vsSrc.size(), nullptr, nullptr, nullptr, "main", "vs_5_0", 0, 0, &vsBlob, &errorBlob);
+    if (FAILED(hr)) {
+        if (errorBlob) { std::cerr << "[Shape VS] " << (char*)errorBlob->GetBufferPointer() << std::endl; errorBlob->Release(); }
+        return;
+    }
+    hr = D3DCompile(psSrc, strlen(psSrc), nullptr, nullptr, nullptr, "main", "ps_5_0", 0, 0, &psBlob, &errorBlob);
+    if (FAILED(hr)) {
+        if (errorBlob) { std::cerr << "[Shape PS] " << (char*)errorBlob->GetBufferPointer() << std::endl; errorBlob->Release(); }
+        vsBlob->Release();
+        return;
+    }
+
+    hr = device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &shapeVertexShader);
+    if (FAILED(hr)) std::cerr << "Failed to create shape vertex shader\n";
+    hr = device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, &shapePixelShader);
+    if (FAILED(hr)) std::cerr << "Failed to create shape pixel shader\n";
+
+    // Input layout matching ShapeInstance, one element per instance
+    D3D11_INPUT_ELEMENT_DESC layout[] = {
+        { "RECT",  0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM,     0, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "SHAPE", 0, DXGI_FORMAT_R32G32_FLOAT,       0, 20, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    };
+    hr = device->CreateInputLayout(layout, ARRAYSIZE(layout), vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), &shapeInputLayout);
+    if (FAILED(hr)) std::cerr << "Failed to create shape input layout\n";
+
+    vsBlob->Release();
+    psBlob->Release();
+}
+
+void Renderer::Begin() {
+    // published with the frame index, SetWindowSize may run while other
+    // threads record
+    frameWidth.store(windowWidth, std::memory_order_relaxed);
+    frameHeight.store(windowHeight, std::memory_order_relaxed);
+    frameIndex.fetch_add(1, std::memory_order_release);
+    drawList.Clear();
+    SetTargetList(nullptr);
+    drawList.PushClipRect({ 0.f, 0.f, (float)windowWidth, (float)windowHeight }, false);
+
+    // a new circle tolerance is taken over between frames, when no worker
+    // reads the table, and changes tessellation under unchanged window hashes
+    if (circleTable.ApplyMaxError()) {
+        ui->InvalidateCaches();
+        InvalidateFrame();
+    }
+
+    // no device calls here, pipeline state is set when the frame is drawn
+    // (possibly on the render thread)
+
+    //update mouse
+    if (device) ui->UpdateMouseAndKey(hwnd);
+}
 
-    // If area < 0, vertices are clockwise, so swap to make CCW
-    if (area < 0) {
-        std::swap(b, c);
+// Bounding box of the points grown by pad on every side
+static Rect PointBounds(const Vec2* pts, int count, float pad = 0.f)
+{
+    Rect r = { pts[0].x, pts[0].y, pts[0].x, pts[0].y };
+    for (int i = 1; i < count; i++) {
+        r.left = std::min(r.left, pts[i].x);
+        r.top = std::min(r.top, pts[i].y);
+        r.right = std::max(r.right, pts[i].x);
+        r.bottom = std::max(r.bottom, pts[i].y);
     }
+    return { r.left - pad, r.top - pad, r.right + pad, r.bottom + pad };
+}
 
-    auto toNDC = [this](Vec2 p) -> Vec2 {
-        return {
-            (p.x / windowWidth) * 2.0f - 1.0f,
-            1.0f - (p.y / windowHeight) * 2.0f
-        };
-        };
+void Renderer::AddTriangle(Vec2 a, Vec2 b, Vec2 c, const Color& color)
+{
+    DrawList& list = CurrentList();
+    Vec2 pts[3] = { a, b, c };
+    if (!list.IsVisible(PointBounds(pts, 3))) return;
+
+    uint32_t col = color.ToRGBA8();
+    list.PrimReserve(3, 3);
+    list.PrimWriteIdx(list.vtxCurrentIdx);
+    list.PrimWriteIdx(list.vtxCurrentIdx + 1);
+    list.PrimWriteIdx(list.vtxCurrentIdx + 2);
+    list.PrimWriteVtx(a.x, a.y, 0, 0, col);
+    list.PrimWriteVtx(b.x, b.y, 0, 0, col);
+    list.PrimWriteVtx(c.x, c.y, 0, 0, col);
+}
 
-    Vec2 ndc_a = toNDC(a);
-    Vec2 ndc_b = toNDC(b);
-    Vec2 ndc_c = toNDC(c);
+// Convex quad a-b-c-d, 4 vertices shared by both triangles
+void Renderer::AddQuadFilled(Vec2 a, Vec2 b, Vec2 c, Vec2 d, const Color& color)
+{
+    DrawList& list = CurrentList();
+    Vec2 pts[4] = { a, b, c, d };
+    if (!list.IsVisible(PointBounds(pts, 4))) return;
 
-    vertexBufferData.push_back({ ndc_a.x, ndc_a.y, 0.f, color.r, color.g, color.b, color.a, 0.f, 0.f, 0.f });
-    vertexBufferData.push_back({ ndc_b.x, ndc_b.y, 0.f, color.r, color.g, color.b, color.a, 0.f, 0.f, 0.f });
-    vertexBufferData.push_back({ ndc_c.x, ndc_c.y, 0.f, color.r, color.g, color.b, color.a, 0.f, 0.f, 0.f });
+    list.PrimReserve(4, 6);
+    list.PrimQuad(a, b, c, d, color.ToRGBA8());
 }
 
 void Renderer::AddLine(Vec2 a, Vec2 b, const Color& color, float thickness)
 {
+    DrawList& list = CurrentList();
     Vec2 dir = b - a;
     float len = std::sqrt(dir.x * dir.x + dir.y * dir.y);
-    if (len == 0.0f) return;
-    dir.x /= len;
-    dir.y /= len;
+    if (!(len > 0.0f)) return;      // zero length, or NaN in a coordinate
+
+    Vec2 pts[2] = { a, b };
+    if (!list.IsVisible(PointBounds(pts, 2, thickness * 0.5f))) return;
 
     // Perpendicular vector scaled by half thickness
-    Vec2 normal = { -dir.y * thickness * 0.5f, dir.x * thickness * 0.5f };
+    float scale = thickness * 0.5f / len;
+    Vec2 normal = { -dir.y * scale, dir.x * scale };
 
-    // Four corners of quad
-    Vec2 v0 = a + normal;
-    Vec2 v1 = b + normal;
-    Vec2 v2 = b - normal;
-    Vec2 v3 = a - normal;
+    list.PrimReserve(4, 6);
+    list.PrimQuad(a + normal, b + normal, b - normal, a - normal, color.ToRGBA8());
+}
 
-    AddTriangle(v0, v1, v2, color);
-    AddTriangle(v2, v3, v0, color);
+// Copies points to out without consecutive repeats (and without a closing
+// point equal to the first when closed), repeated points have no direction
+static int CleanPoints(const Vec2* points, int count, bool closed, std::vector<Vec2>& out)
+{
+    out.clear();
+    for (int i = 0; i < count; i++) {
+        if (out.empty() || out.back() != points[i]) out.push_back(points[i]);
+    }
+    if (closed && out.size() > 1 && out.back() == out.front()) out.pop_back();
+    return (int)out.size();
+}
+
+// Stroke through the given points as one continuous strip: every point is
+// shared by the segments meeting there, joins are mitered up to twice the half
+// thickness and bevelled beyond that. Open ends are cut flat.
+void Renderer::AddPolyline(const Vec2* points, int count, const Color& color, bool closed, float thickness)
+{
+    DrawList& list = CurrentList();
+    if (count < 2 || thickness <= 0.f) return;
+
+    std::vector<Vec2>& pts = list.tempPoints;
+    int n = CleanPoints(points, count, closed, pts);
+    if (n < 2) return;
+    if (n < 3) closed = false;
+
+    // miters reach out at most 2x the half thickness
+    float halfThickness = thickness * 0.5f;
+    if (!list.IsVisible(PointBounds(pts.data(), n, thickness))) return;
+
+    uint32_t col = color.ToRGBA8();
+
+    // at most 4 vertices per point, keep every piece inside one 16-bit command
+    const int maxPoints = 16000;
+    if (n <= maxPoints) {
+        StrokePolyline(pts.data(), n, closed, col, halfThickness);
+        return;
+    }
+
+    // Pieces share their seam points and are told the points on either side,
+    // so every seam gets the join the unsplit stroke has there, the closing
+    // one included
+    if (closed) {
+        pts.push_back(pts.front());
+        n++;
+    }
+    for (int start = 0; start < n - 1; start += maxPoints - 1) {
+        int end = std::min(start + maxPoints, n) - 1;
+        const Vec2* before = start > 0 ? &pts[start - 1] : closed ? &pts[n - 2] : nullptr;
+        const Vec2* after = end < n - 1 ? &pts[end + 1] : closed ? &pts[1] : nullptr;
+        StrokePolyline(pts.data() + start, end - start + 1, false, col, halfThickness, before, after);
+    }
+}
+
+// Unit normal of the segment a -> b, to its left on screen
+static Vec2 SegmentNormal(Vec2 a, Vec2 b)
+{
+    Vec2 d = b - a;
+
+    // horizontal and vertical segments need no normalisation
+    if (d.y == 0.f) return { 0.f, d.x > 0.f ? 1.f : -1.f };
+    if (d.x == 0.f) return { d.y > 0.f ? -1.f : 1.f, 0.f };
+    float inv = 1.f / std::sqrt(d.x * d.x + d.y * d.y);
+    return { -d.y * inv, d.x * inv };
+}
+
+// before/after are the points next to an open piece of a longer stroke: the
+// join at that end is built like in the whole stroke, except that a bevel
+// at the end is left to the piece starting there, this one stops at the
+// pair its last segment ends on
+void Renderer::StrokePolyline(const Vec2* pts, int n, bool closed, uint32_t col, float halfThickness,
+    const Vec2* before, const Vec2* after)
+{
+    DrawList& list = CurrentList();
+    // |average of the two normals|^2 below this means the miter would be
+    // longer than 2x the half thickness, those joins are bevelled
+    const float miterLimitSq = 0.25f;
+
+    int segCount = closed ? n : n - 1;
+    std::vector<Vec2>& normals = list.tempNormals;
+    normals.resize(segCount);
+    for (int i = 0; i < segCount; i++)
+        normals[i] = SegmentNormal(pts[i], pts[i + 1 == n ? 0 : i + 1]);
+
+    Vec2 beforeNormal = before ? SegmentNormal(*before, pts[0]) : Vec2{ 0.f, 0.f };
+    Vec2 afterNormal = after ? SegmentNormal(pts[n - 1], *after) : Vec2{ 0.f, 0.f };
+
+    auto joinNormals = [&](int i, Vec2& n0, Vec2& n1, Vec2& avg) {
+        n0 = i > 0 ? normals[i - 1] : closed ? normals[segCount - 1] : beforeNormal;
+        n1 = i < segCount ? normals[i] : afterNormal;
+        avg = { (n0.x + n1.x) * 0.5f, (n0.y + n1.y) * 0.5f };
+        return avg.x * avg.x + avg.y * avg.y;
+    };
+
+    int firstJoin = closed || before ? 0 : 1;
+    int lastJoin = closed || after ? n - 1 : n - 2;
+    int lastBevel = !closed && after ? n - 2 : lastJoin;
+    int bevels = 0;
+    for (int i = firstJoin; i <= lastBevel; i++) {
+        Vec2 n0, n1, avg;
+        if (joinNormals(i, n0, n1, avg) < miterLimitSq) bevels++;
+    }
+
+    list.PrimReserve(n * 2 + bevels * 2, segCount * 6 + bevels * 6);
+
+    auto writeSegment = [&](DrawIndex a, DrawIndex b) {
+        list.PrimWriteIdx(a); list.PrimWriteIdx(b); list.PrimWriteIdx(b + 1);
+        list.PrimWriteIdx(b + 1); list.PrimWriteIdx(a + 1); list.PrimWriteIdx(a);
+    };
+
+    DrawIndex firstIn = 0, prevOut = 0;
+    for (int i = 0; i < n; i++) {
+        const Vec2& p = pts[i];
+        DrawIndex inIdx = list.vtxCurrentIdx;
+        DrawIndex outIdx = inIdx;
+
+        if (i < firstJoin || i > lastJoin) {
+            // flat end of an open polyline
+            const Vec2& nrm = normals[i == 0 ? 0 : segCount - 1];
+            Vec2 o = { nrm.x * halfThickness, nrm.y * halfThickness };
+            list.PrimWriteVtx(p.x + o.x, p.y + o.y, 0, 0, col);
+            list.PrimWriteVtx(p.x - o.x, p.y - o.y, 0, 0, col);
+        }
+        else {
+            Vec2 n0, n1, avg;
+            float d2 = joinNormals(i, n0, n1, avg);
+            if (d2 >= miterLimitSq) {
+                // miter: one pair shared by both segments
+                float scale = halfThickness / d2;
+                Vec2 m = { avg.x * scale, avg.y * scale };
+                list.PrimWriteVtx(p.x + m.x, p.y + m.y, 0, 0, col);
+                list.PrimWriteVtx(p.x - m.x, p.y - m.y, 0, 0, col);
+            }
+            else if (i == n - 1 && !closed) {
+                // seam into the next piece, which draws the bevel
+                list.PrimWriteVtx(p.x + n0.x * halfThickness, p.y + n0.y * halfThickness, 0, 0, col);
+                list.PrimWriteVtx(p.x - n0.x * halfThickness, p.y - n0.y * halfThickness, 0, 0, col);
+            }
+            else {
+                // bevel: end pair of the incoming segment, start pair of the
+                // outgoing one and two triangles closing the gap between them
+                outIdx = inIdx + 2;
+                list.PrimWriteVtx(p.x + n0.x * halfThickness, p.y + n0.y * halfThickness, 0, 0, col);
+                list.PrimWriteVtx(p.x - n0.x * halfThickness, p.y - n0.y * halfThickness, 0, 0, col);
+                list.PrimWriteVtx(p.x + n1.x * halfThickness, p.y + n1.y * halfThickness, 0, 0, col);
+                list.PrimWriteVtx(p.x - n1.x * halfThickness, p.y - n1.y * halfThickness, 0, 0, col);
+                list.PrimWriteIdx(inIdx); list.PrimWriteIdx(outIdx); list.PrimWriteIdx(inIdx + 1);
+                list.PrimWriteIdx(inIdx + 1); list.PrimWriteIdx(outIdx + 1); list.PrimWriteIdx(inIdx);
+            }
+        }
+
+        if (i == 0) firstIn = inIdx;
+        else writeSegment(prevOut, inIdx);
+        prevOut = outIdx;
+    }
+
+    if (closed) writeSegment(prevOut, firstIn);
+}
+
+// Fan from the first point, only correct for convex polygons
+void Renderer::AddConvexPolyFilled(const Vec2* points, int count, const Color& color)
+{
+    DrawList& list = CurrentList();
+    if (count < 3) return;
+    if (!list.IsVisible(PointBounds(points, count))) return;
+    uint32_t col = color.ToRGBA8();
+
+    // every fan piece repeats the first point to stay within a 16-bit command
+    const int maxVertices = 65536;
+    for (int start = 1; start < count - 1; start += maxVertices - 2) {
+        int pieceCount = std::min(maxVertices - 1, count - start);
+        list.PrimReserve(pieceCount + 1, (pieceCount - 1) * 3);
+
+        DrawIndex base = list.vtxCurrentIdx;
+        list.PrimWriteVtx(points[0].x, points[0].y, 0, 0, col);
+        for (int i = 0; i < pieceCount; i++) {
+            const Vec2& p = points[start + i];
+            list.PrimWriteVtx(p.x, p.y, 0, 0, col);
+        }
+        for (int i = 1; i < pieceCount; i++) {
+            list.PrimWriteIdx(base);
+            list.PrimWriteIdx(base + i);
+            list.PrimWriteIdx(base + i + 1);
+        }
+    }
+}
+
+// Any simple polygon (no self intersections), ear clipped
+void Renderer::AddConcavePolyFilled(const Vec2* points, int count, const Color& color)
+{
+    DrawList& list = CurrentList();
+    std::vector<Vec2>& pts = list.tempPoints;
+    int n = CleanPoints(points, count, true, pts);
+    if (n < 3) return;
+    if (!list.IsVisible(PointBounds(pts.data(), n))) return;
+
+    uint32_t col = color.ToRGBA8();
+
+    // the triangulation addresses every point from one command
+    const int maxVertices = 65536;
+    if (n <= maxVertices) {
+        list.PrimReserve(n, (n - 2) * 3);
+
+        DrawIndex base = list.vtxCurrentIdx;
+        for (int i = 0; i < n; i++)
+            list.PrimWriteVtx(pts[i].x, pts[i].y, 0, 0, col);
+
+        list.idxWritePtr += list.triangulator.Triangulate(pts.data(), n, base, list.idxWritePtr);
+        return;
+    }
+
+    // Too many points for 16-bit indices: triangulate with 32-bit ones and
+    // emit the triangles in order, in batches that copy the points they use,
+    // at most maxVertices per batch. Points shared by two batches are
+    // written twice, the triangles are the same as in one command.
+    std::vector<uint32_t> tris((size_t)(n - 2) * 3);
+    list.triangulator.Triangulate(pts.data(), n, tris.data());
+
+    std::vector<int> slot(n, -1);           // point -> vertex in the current batch
+    std::vector<int> batch;                 // points of the current batch, by vertex
+    size_t triCount = tris.size() / 3;
+    for (size_t t = 0; t < triCount;) {
+        size_t first = t;
+        batch.clear();
+        for (; t < triCount; t++) {
+            const uint32_t* tri = &tris[t * 3];
+            int fresh = (slot[tri[0]] < 0) + (slot[tri[1]] < 0) + (slot[tri[2]] < 0);
+            if ((int)batch.size() + fresh > maxVertices) break;
+            for (int k = 0; k < 3; k++) {
+                if (slot[tri[k]] >= 0) continue;
+                slot[tri[k]] = (int)batch.size();
+                batch.push_back((int)tri[k]);
+            }
+        }
+
+        list.PrimReserve(batch.size(), (t - first) * 3);
+        DrawIndex base = list.vtxCurrentIdx;
+        for (int p : batch)
+            list.PrimWriteVtx(pts[p].x, pts[p].y, 0, 0, col);
+        for (size_t i = first * 3; i < t * 3; i++)
+            list.PrimWriteIdx((DrawIndex)(base + slot[tris[i]]));
+
+        for (int p : batch) slot[p] = -1;
+    }
 }
 
 void Renderer::AddRectangle(Vec2 topLeft, Vec2 size, const Color& color, float thickness)
 {
-    Vec2 topRight = { topLeft.x + size.x, topLeft.y };
-    Vec2 bottomRight = { topLeft.x + size.x, topLeft.y + size.y };
-    Vec2 bottomLeft = { topLeft.x, topLeft.y + size.y };
+    Vec2 corners[4] = {
+        topLeft,
+        { topLeft.x + size.x, topLeft.y },
+        { topLeft.x + size.x, topLeft.y + size.y },
+        { topLeft.x, topLeft.y + size.y },
+    };
+    AddPolyline(corners, 4, color, true, thickness);
+}
+
+void Renderer::AddRectangleFilled(Vec2 topLeft, Vec2 size, const Color& color, float rounding)
+{
+    DrawList& list = CurrentList();
+    Vec2 pts[2] = { topLeft, topLeft + size };
+    Rect bounds = PointBounds(pts, 2);
+    if (!list.IsVisible(bounds)) return;
+
+    // the instance is built either way, the CPU path expands it the same
+    // way the instanced vertex shader does
+    RectInstance rect;
+    rect.x = bounds.left;
+    rect.y = bounds.top;
+    rect.w = bounds.right - bounds.left;
+    rect.h = bounds.bottom - bounds.top;
+    rect.col = color.ToRGBA8();
+    rect.radius = std::min({ rounding, rect.w * 0.5f, rect.h * 0.5f });
+    if (rect.radius < 0.5f) rect.radius = 0.f;
+
+    if (instancedRects) {
+        list.AddRectInstance(rect);
+        return;
+    }
 
-    AddLine({topLeft.x - 1.f , topLeft.y - 1.f}, topRight, color, thickness);
-    AddLine(topRight, bottomRight, color, thickness);
-    AddLine(bottomRight, bottomLeft, color, thickness);
-    AddLine(bottomLeft, topLeft, color, thickness);
+    if (rect.radius == 0.f) {
+        list.PrimReserve(4, 6);
+        list.PrimRect({ rect.x, rect.y }, { rect.x + rect.w, rect.y + rect.h }, rect.col);
+        return;
+    }
+
+    list.PrimReserve(RectOutlinePoints, (RectOutlinePoints - 2) * 3);
+    DrawIndex base = list.vtxCurrentIdx;
+    for (int i = 0; i < RectOutlinePoints; i++) {
+        Vec2 p = RectOutlinePoint(rect, i);
+        list.PrimWriteVtx(p.x, p.y, 0, 0, rect.col);
+    }
+    for (int i = 1; i < RectOutlinePoints - 1; i++) {
+        list.PrimWriteIdx(base);
+        list.PrimWriteIdx(base + i);
+        list.PrimWriteIdx(base + i + 1);
+    }
 }
 
-void Renderer::AddRectangleFilled(Vec2 topLeft, Vec2 size, const Color& color)
+void Renderer::AddRectRounded(Vec2 topLeft, Vec2 size, const Color& color, float rounding, float thickness)
 {
-    Vec2 topRight = { topLeft.x + size.x, topLeft.y };
-    Vec2 bottomRight = { topLeft.x + size.x, topLeft.y + size.y };
-    Vec2 bottomLeft = { topLeft.x, topLeft.y + size.y };
+    Vec2 pts[2] = { topLeft, topLeft + size };
+    Rect bounds = PointBounds(pts, 2);
+    float w = bounds.right - bounds.left;
+    float h = bounds.bottom - bounds.top;
+    float radius = std::clamp(rounding, 0.f, std::min(w, h) * 0.5f);
+    AddShape(bounds.left, bounds.top, w, h, radius, std::max(thickness, 0.f), color);
+}
 
-    AddTriangle(topLeft, topRight, bottomRight, color);
-    AddTriangle(bottomRight, bottomLeft, topLeft, color);
+void Renderer::AddRing(Vec2 center, float innerRadius, float outerRadius, const Color& color)
+{
+    if (outerRadius <= 0.f || innerRadius >= outerRadius) return;
+    float thickness = innerRadius > 0.f ? outerRadius - innerRadius : 0.f;
+    AddShape(center.x - outerRadius, center.y - outerRadius, outerRadius * 2.f, outerRadius * 2.f, outerRadius, thickness, color);
 }
 
-void Renderer::AddCircle(Vec2 center, float radius, const Color& color, float thickness, int segments)
+void Renderer::AddCircleAnalytic(Vec2 center, float radius, const Color& color, float thickness)
 {
-    float step = 2.0f * 3.14159265358979323846 / segments;
-    for (int i = 0; i < segments; i++)
-    {
-        float theta1 = i * step;
-        float theta2 = (i + 1) * step;
+    if (radius <= 0.f) return;
+    if (thickness <= 0.f) {
+        AddShape(center.x - radius, center.y - radius, radius * 2.f, radius * 2.f, radius, 0.f, color);
+        return;
+    }
+    float half = thickness * 0.5f;
+    AddRing(center, std::max(radius - half, 0.f), radius + half, color);
+}
 
-        Vec2 p1 = { center.x + radius * std::cos(theta1),
-                    center.y + radius * std::sin(theta1) };
+void Renderer::AddShape(float x, float y, float w, float h, float radius, float thickness, const Color& color)
+{
+    DrawList& list = CurrentList();
+    if (w <= 0.f || h <= 0.f) return;
+    if (!list.IsVisible({ x - ShapeFringe, y - ShapeFringe, x + w + ShapeFringe, y + h + ShapeFringe })) return;
+
+    ShapeInstance shape;
+    shape.x = x;
+    shape.y = y;
+    shape.w = w;
+    shape.h = h;
+    shape.col = color.ToRGBA8();
+    shape.radius = radius;
+    shape.thickness = thickness;
+    list.AddShapeInstance(shape);
+}
+
+// Primitives a bulk call draws and the stride of its colours (0 = one shared)
+static size_t BulkCount(size_t count, std::span<const uint32_t> colors, size_t& colorStride)
+{
+    colorStride = colors.size() == 1 ? 0 : 1;
+    return colorStride ? std::min(count, colors.size()) : count;
+}
+
+// Quads per reserve. Small enough that a chunk of mostly clipped primitives
+// does not force a new command by reserving 16-bit index space it never uses.
+constexpr size_t BulkChunk = 1024;
+
+// Runs expand(first, n, baseIndex, vtx, idx), which writes up to n quads and
+// returns how many it wrote, over count primitives a chunk at a time, and
+// hands the slots of the skipped ones back.
+template <typename Expand>
+static void BulkQuads(DrawList& list, size_t count, Expand expand)
+{
+    for (size_t first = 0; first < count; first += BulkChunk) {
+        size_t n = std::min(count - first, BulkChunk);
+        list.PrimReserve(n * 4, n * 6);
+        size_t written = expand(first, n, list.vtxCurrentIdx, list.vtxWritePtr, list.idxWritePtr);
+        list.vtxWritePtr += written * 4;
+        list.idxWritePtr += written * 6;
+        list.vtxCurrentIdx = (DrawIndex)(list.vtxCurrentIdx + written * 4);
+        list.PrimUnreserve((n - written) * 4, (n - written) * 6);
+    }
+}
 
-        Vec2 p2 = { center.x + radius * std::cos(theta2),
-                    center.y + radius * std::sin(theta2) };
+void Renderer::AddRectsFilled(std::span<const Rect> rects, std::span<const uint32_t> colors)
+{
+    DrawList& list = CurrentList();
+    size_t stride;
+    size_t count = BulkCount(rects.size(), colors, stride);
+    if (count == 0) return;
 
-        AddLine(p1, p2, color, thickness);
+    if (instancedRects) {
+        for (size_t i = 0; i < count; i++) {
+            const Rect& r = rects[i];
+            if (!list.IsVisible(r)) continue;
+            RectInstance rect;
+            rect.x = r.left;
+            rect.y = r.top;
+            rect.w = r.right - r.left;
+            rect.h = r.bottom - r.top;
+            rect.col = colors[i * stride];
+            rect.radius = 0.f;
+            list.AddRectInstance(rect);
+        }
+        return;
     }
+
+    const Rect clip = list.GetClipRect();
+    BulkQuads(list, count, [&](size_t first, size_t n, DrawIndex base, Vertex* vtx, DrawIndex* idx) {
+        return ExpandRects(simdLevel, rects.data() + first, n, colors.data() + first * stride, stride, clip, base, vtx, idx);
+    });
+}
+
+void Renderer::AddPoints(std::span<const Vec2> points, std::span<const uint32_t> colors, float size)
+{
+    DrawList& list = CurrentList();
+    size_t stride;
+    size_t count = BulkCount(points.size(), colors, stride);
+    if (count == 0 || size <= 0.f) return;
+
+    const Rect clip = list.GetClipRect();
+    float half = size * 0.5f;
+    BulkQuads(list, count, [&](size_t first, size_t n, DrawIndex base, Vertex* vtx, DrawIndex* idx) {
+        return ExpandPoints(simdLevel, points.data() + first, n, colors.data() + first * stride, stride, half, clip, base, vtx, idx);
+    });
+}
+
+void Renderer::AddLines(std::span<const Vec2> endpoints, std::span<const uint32_t> colors, float thickness)
+{
+    DrawList& list = CurrentList();
+    size_t stride;
+    size_t count = BulkCount(endpoints.size() / 2, colors, stride);
+    if (count == 0) return;
+
+    const Rect clip = list.GetClipRect();
+    float half = thickness * 0.5f;
+    BulkQuads(list, count, [&](size_t first, size_t n, DrawIndex base, Vertex* vtx, DrawIndex* idx) {
+        return ExpandLines(simdLevel, endpoints.data() + first * 2, n, colors.data() + first * stride, stride, half, clip, base, vtx, idx);
+    });
+}
+
+// Instances are already one small record per circle, there is nothing to
+// expand, so this is AddCircleAnalytic without the per-call overhead
+void Renderer::AddCirclesFilled(std::span<const Vec2> centers, std::span<const float> radii, std::span<const uint32_t> colors)
+{
+    DrawList& list = CurrentList();
+    size_t stride;
+    size_t count = BulkCount(std::min(centers.size(), radii.size()), colors, stride);
+
+    for (size_t i = 0; i < count; i++) {
+        float r = radii[i];
+        if (r <= 0.f) continue;
+        ShapeInstance shape;
+        shape.x = centers[i].x - r;
+        shape.y = centers[i].y - r;
+        shape.w = r * 2.f;
+        shape.h = r * 2.f;
+        shape.col = colors[i * stride];
+        shape.radius = r;
+        shape.thickness = 0.f;
+        if (!list.IsVisible({ shape.x - ShapeFringe, shape.y - ShapeFringe, shape.x + shape.w + ShapeFringe, shape.y + shape.h + ShapeFringe })) continue;
+        list.AddShapeInstance(shape);
+    }
+}
+
+void Renderer::AddCircle(Vec2 center, float radius, const Color& color, float thickness, int segments)
+{
+    DrawList& list = CurrentList();
+    if (radius <= 0.f || thickness <= 0.f) return;
+
+    float outer = radius + thickness;
+    if (!list.IsVisible({ center.x - outer, center.y - outer, center.x + outer, center.y + outer })) return;
+
+    int n = segments > 0 ? segments : circleTable.SegmentCount(radius);
+    n = std::clamp(n, 3, CircleTable::MaxSegments);
+    const Vec2* unit = circleTable.UnitCircle(n);
+
+    std::vector<Vec2>& pts = list.tempPoints;
+    pts.resize(n);
+    for (int i = 0; i < n; i++)
+        pts[i] = { center.x + unit[i].x * radius, center.y + unit[i].y * radius };
+
+    StrokePolyline(pts.data(), n, true, color.ToRGBA8(), thickness * 0.5f);
 }
 
 void Renderer::AddCircleFilled(Vec2 center, float radius, const Color& color, int segments)
 {
-    float step = 2.0f * 3.14159265358979323846 / segments;
-    for (int i = 0; i < segments; i++)
+    DrawList& list = CurrentList();
+    if (radius <= 0.f) return;
+    if (!list.IsVisible({ center.x - radius, center.y - radius, center.x + radius, center.y + radius })) return;
+
+    int n = segments > 0 ? segments : circleTable.SegmentCount(radius);
+    n = std::clamp(n, 3, CircleTable::MaxSegments);
+    const Vec2* unit = circleTable.UnitCircle(n);
+
+    // triangle fan around a shared center vertex, each rim vertex is emitted once
+    uint32_t col = color.ToRGBA8();
+    list.PrimReserve(n + 1, n * 3);
+
+    DrawIndex idx = list.vtxCurrentIdx;
+    for (int i = 0; i < n; i++)
     {
-        float theta1 = i * step;
-        float theta2 = (i + 1) * step;
+        int next = (i + 1) % n;
+        list.PrimWriteIdx(idx);
+        list.PrimWriteIdx((DrawIndex)(idx + 1 + i));
+        list.PrimWriteIdx((DrawIndex)(idx + 1 + next));
+    }
+
+    list.PrimWriteVtx(center.x, center.y, 0, 0, col);
+    for (int i = 0; i < n; i++)
+        list.PrimWriteVtx(center.x + unit[i].x * radius, center.y + unit[i].y * radius, 0, 0, col);
+}
+
+void Renderer::PathArcTo(Vec2 center, float radius, float aMin, float aMax, int segments)
+{
+    DrawList& list = CurrentList();
+    std::vector<Vec2>& path = list.path;
+    if (radius <= 0.f) {
+        path.push_back(center);
+        return;
+    }
+
+    // explicit segment count: spread them evenly over the arc
+    if (segments > 0) {
+        for (int i = 0; i <= segments; i++) {
+            float a = aMin + (aMax - aMin) * i / segments;
+            path.push_back({ center.x + std::cos(a) * radius, center.y + std::sin(a) * radius });
+        }
+        return;
+    }
+
+    // Otherwise take the interior points from the same unit circle a full
+    // circle of this radius uses, only the two end points need cos/sin.
+    const float twoPi = 6.28318530717958647692f;
+    int n = circleTable.SegmentCount(radius);
+    const Vec2* unit = circleTable.UnitCircle(n);
+    float step = twoPi / n;
+
+    path.push_back({ center.x + std::cos(aMin) * radius, center.y + std::sin(aMin) * radius });
+    if (aMax >= aMin) {
+        int first = (int)std::floor(aMin / step) + 1;
+        int last = (int)std::ceil(aMax / step) - 1;
+        for (int i = first; i <= last; i++) {
+            const Vec2& u = unit[((i % n) + n) % n];
+            path.push_back({ center.x + u.x * radius, center.y + u.y * radius });
+        }
+    }
+    else {
+        int first = (int)std::ceil(aMin / step) - 1;
+        int last = (int)std::floor(aMax / step) + 1;
+        for (int i = first; i >= last; i--) {
+            const Vec2& u = unit[((i % n) + n) % n];
+            path.push_back({ center.x + u.x * radius, center.y + u.y * radius });
+        }
+    }
+    path.push_back({ center.x + std::cos(aMax) * radius, center.y + std::sin(aMax) * radius });
+}
+
+// De Casteljau subdivision until the curve is within the tolerance of the
+// chord, so flat stretches end up as one segment and tight bends get many.
+// tolSq is the squared tolerance in pixels.
+static void FlattenQuadratic(std::vector<Vec2>& out, Vec2 p1, Vec2 p2, Vec2 p3, float tolSq, int level)
+{
+    // a quadratic strays from its chord by half the control point's distance
+    // to it, so the control point may be up to 2x the tolerance away
+    float dx = p3.x - p1.x, dy = p3.y - p1.y;
+    float chordSq = dx * dx + dy * dy;
+    bool flat;
+    if (chordSq > 1e-6f) {
+        float d = (p2.x - p3.x) * dy - (p2.y - p3.y) * dx;
+        flat = d * d <= 4.f * tolSq * chordSq;
+    }
+    else {
+        // end meets start, measure the control point against it instead
+        float ex = p2.x - p1.x, ey = p2.y - p1.y;
+        flat = ex * ex + ey * ey <= 4.f * tolSq;
+    }
+    if (level >= 10 || flat) {
+        out.push_back(p3);
+        return;
+    }
+
+    Vec2 p12 = { (p1.x + p2.x) * 0.5f, (p1.y + p2.y) * 0.5f };
+    Vec2 p23 = { (p2.x + p3.x) * 0.5f, (p2.y + p3.y) * 0.5f };
+    Vec2 mid = { (p12.x + p23.x) * 0.5f, (p12.y + p23.y) * 0.5f };
+    FlattenQuadratic(out, p1, p12, mid, tolSq, level + 1);
+    FlattenQuadratic(out, mid, p23, p3, tolSq, level + 1);
+}
+
+static void FlattenCubic(std::vector<Vec2>& out, Vec2 p1, Vec2 p2, Vec2 p3, Vec2 p4, float tolSq, int level)
+{
+    float dx = p4.x - p1.x, dy = p4.y - p1.y;
+    float chordSq = dx * dx + dy * dy;
+    bool flat;
+    if (chordSq > 1e-6f) {
+        float d2 = std::fabs((p2.x - p4.x) * dy - (p2.y - p4.y) * dx);
+        float d3 = std::fabs((p3.x - p4.x) * dy - (p3.y - p4.y) * dx);
+        flat = (d2 + d3) * (d2 + d3) <= tolSq * chordSq;
+    }
+    else {
+        float e2x = p2.x - p1.x, e2y = p2.y - p1.y;
+        float e3x = p3.x - p1.x, e3y = p3.y - p1.y;
+        flat = std::max(e2x * e2x + e2y * e2y, e3x * e3x + e3y * e3y) <= tolSq;
+    }
+    if (level >= 10 || flat) {
+        out.push_back(p4);
+        return;
+    }
+
+    Vec2 p12 = { (p1.x + p2.x) * 0.5f, (p1.y + p2.y) * 0.5f };
+    Vec2 p23 = { (p2.x + p3.x) * 0.5f, (p2.y + p3.y) * 0.5f };
+    Vec2 p34 = { (p3.x + p4.x) * 0.5f, (p3.y + p4.y) * 0.5f };
+    Vec2 p123 = { (p12.x + p23.x) * 0.5f, (p12.y + p23.y) * 0.5f };
+    Vec2 p234 = { (p23.x + p34.x) * 0.5f, (p23.y + p34.y) * 0.5f };
+    Vec2 mid = { (p123.x + p234.x) * 0.5f, (p123.y + p234.y) * 0.5f };
+    FlattenCubic(out, p1, p12, p123, mid, tolSq, level + 1);
+    FlattenCubic(out, mid, p234, p34, p4, tolSq, level + 1);
+}
+
+void Renderer::PathBezierQuadraticTo(Vec2 p2, Vec2 p3, int segments)
+{
+    DrawList& list = CurrentList();
+    std::vector<Vec2>& path = list.path;
+    if (path.empty()) { path.push_back(p3); return; }
+    Vec2 p1 = path.back();
+
+    if (segments <= 0) {
+        FlattenQuadratic(path, p1, p2, p3, curveTolerance * curveTolerance, 0);
+        return;
+    }
+
+    float step = 1.f / segments;
+    for (int i = 1; i <= segments; i++) {
+        float t = i * step, u = 1.f - t;
+        float w1 = u * u, w2 = 2.f * u * t, w3 = t * t;
+        path.push_back({ w1 * p1.x + w2 * p2.x + w3 * p3.x, w1 * p1.y + w2 * p2.y + w3 * p3.y });
+    }
+}
+
+void Renderer::PathBezierCubicTo(Vec2 p2, Vec2 p3, Vec2 p4, int segments)
+{
+    DrawList& list = CurrentList();
+    std::vector<Vec2>& path = list.path;
+    if (path.empty()) { path.push_back(p4); return; }
+    Vec2 p1 = path.back();
 
-        Vec2 p1 = { center.x + radius * std::cos(theta1),
-                    center.y + radius * std::sin(theta1) };
+    if (segments <= 0) {
+        FlattenCubic(path, p1, p2, p3, p4, curveTolerance * curveTolerance, 0);
+        return;
+    }
+
+    float step = 1.f / segments;
+    for (int i = 1; i <= segments; i++) {
+        float t = i * step, u = 1.f - t;
+        float w1 = u * u * u, w2 = 3.f * u * u * t, w3 = 3.f * u * t * t, w4 = t * t * t;
+        path.push_back({ w1 * p1.x + w2 * p2.x + w3 * p3.x + w4 * p4.x,
+                         w1 * p1.y + w2 * p2.y + w3 * p3.y + w4 * p4.y });
+    }
+}
+
+void Renderer::AddBezierQuadratic(Vec2 p1, Vec2 p2, Vec2 p3, const Color& color, float thickness, int segments)
+{
+    DrawList& list = CurrentList();
+    // the curve stays inside the hull of its control points
+    Vec2 hull[3] = { p1, p2, p3 };
+    if (!list.IsVisible(PointBounds(hull, 3, thickness))) return;
+
+    PathLineTo(p1);
+    PathBezierQuadraticTo(p2, p3, segments);
+    PathStroke(color, false, thickness);
+}
 
-        Vec2 p2 = { center.x + radius * std::cos(theta2),
-                    center.y + radius * std::sin(theta2) };
+void Renderer::AddBezierCubic(Vec2 p1, Vec2 p2, Vec2 p3, Vec2 p4, const Color& color, float thickness, int segments)
+{
+    DrawList& list = CurrentList();
+    Vec2 hull[4] = { p1, p2, p3, p4 };
+    if (!list.IsVisible(PointBounds(hull, 4, thickness))) return;
+
+    PathLineTo(p1);
+    PathBezierCubicTo(p2, p3, p4, segments);
+    PathStroke(color, false, thickness);
+}
+
+void Renderer::PathStroke(const Color& color, bool closed, float thickness)
+{
+    DrawList& list = CurrentList();
+    AddPolyline(list.path.data(), (int)list.path.size(), color, closed, thickness);
+    list.path.clear();
+}
 
-        AddTriangle(center, p1, p2, color);
+Vec2 Renderer::MeasureText(const std::string& text, float scale) const
+{
+    float width = 0.f, height = 0.f;
+    for (unsigned char c : text) {
+        const FontChar* fc = glyphs[c];
+        if (!fc) continue;
+        width += fc->xadvance * scale;
+        height = std::max(height, (fc->yoffset + fc->h) * scale);
     }
+    return { width, height };
 }
 
-void Renderer::DrawChar(float x, float y, float w, float h,
-    float u0, float v0, float u1, float v1,
-    float r, float g, float b, float a)
+void Renderer::PathFillConvex(const Color& color)
 {
-    // Convert pixel coords to NDC
-    float ndcX = (x / windowWidth) * 2.0f - 1.0f;
-    float ndcY = 1.0f - (y / windowHeight) * 2.0f;
-    float ndcW = (w / windowWidth) * 2.0f;
-    float ndcH = (h / windowHeight) * 2.0f;
+    DrawList& list = CurrentList();
+    AddConvexPolyFilled(list.path.data(), (int)list.path.size(), color);
+    list.path.clear();
+}
 
-    // Triangle 1
-    vertexBufferData.push_back({ ndcX,          ndcY,          0.0f, r, g, b, a, u0, v0, 1.0f });
-    vertexBufferData.push_back({ ndcX + ndcW,   ndcY,          0.0f, r, g, b, a, u1, v0, 1.0f });
-    vertexBufferData.push_back({ ndcX,          ndcY - ndcH,   0.0f, r, g, b, a, u0, v1, 1.0f });
-    // Triangle 2
-    vertexBufferData.push_back({ ndcX + ndcW,   ndcY,          0.0f, r, g, b, a, u1, v0, 1.0f });
-    vertexBufferData.push_back({ ndcX + ndcW,   ndcY - ndcH,   0.0f, r, g, b, a, u1, v1, 1.0f });
-    vertexBufferData.push_back({ ndcX,          ndcY - ndcH,   0.0f, r, g, b, a, u0, v1, 1.0f });
+void Renderer::PathFillConcave(const Color& color)
+{
+    DrawList& list = CurrentList();
+    AddConcavePolyFilled(list.path.data(), (int)list.path.size(), color);
+    list.path.clear();
 }
 
 void Renderer::AddText(float x, float y, const std::string& text, const Color& color, float scale)
 {
+    DrawList& list = CurrentList();
     float cursorX = x;
     if (text.empty()) return;
-    for (char ch : text) {
-        int charId = static_cast<unsigned char>(ch);
-        auto it = fontMap.find(charId);
-        if (it == fontMap.end()) continue;
 
-        const FontChar& fc = it->second;
+    uint32_t col = color.ToRGBA8();
+    const Rect clip = list.GetClipRect();
+    ID3D11ShaderResourceView* prevTexture = list.GetTexture();
+    list.SetTexture(glyphTexture);
+
+    // one reservation per chunk of glyphs, chunks keep it within a 16-bit range
+    const size_t maxChunk = 8192;
+    for (size_t start = 0; start < text.size(); start += maxChunk) {
+        size_t count = std::min(maxChunk, text.size() - start);
+        size_t written = 0;
+        list.PrimReserve(count * 4, count * 6);
+
+        for (size_t i = start; i < start + count; i++) {
+            const FontChar* fc = glyphs[static_cast<unsigned char>(text[i])];
+            if (!fc) continue;
+
+            float xpos = cursorX + fc->xoffset * scale;
+            float ypos = y + fc->yoffset * scale;
+            float w = fc->w * scale;
+            float h = fc->h * scale;
+            cursorX += fc->xadvance * scale;
+
+            // spaces and the like cover nothing, and would divide by zero below
+            if (w <= 0.f || h <= 0.f) continue;
+
+            Rect quad = { xpos, ypos, xpos + w, ypos + h };
+            if (!quad.Overlaps(clip)) continue;
+
+            Vec2 uv0 = { fc->u0, fc->v0 };
+            Vec2 uv1 = { fc->u1, fc->v1 };
+            if (!clip.Contains(quad)) {
+                // cut the glyph at the clip edge and move its UVs along
+                Rect cut = quad.Intersect(clip);
+                float du = (fc->u1 - fc->u0) / w;
+                float dv = (fc->v1 - fc->v0) / h;
+                uv0 = { fc->u0 + (cut.left - quad.left) * du, fc->v0 + (cut.top - quad.top) * dv };
+                uv1 = { fc->u1 - (quad.right - cut.right) * du, fc->v1 - (quad.bottom - cut.bottom) * dv };
+                quad = cut;
+            }
+
+            list.PrimRectUV({ quad.left, quad.top }, { quad.right, quad.bottom }, uv0, uv1, col);
+            written++;
+        }
+
+        // glyphs missing from the font
+        list.PrimUnreserve((count - written) * 4, (count - written) * 6);
+    }
+
+    list.SetTexture(prevTexture);
+}
+
+ImageId Renderer::CreateImage(const uint32_t* pixels, int width, int height)
+{
+    ImageId image = atlas->Add(pixels, width, height);
+    if (image == InvalidImage) std::cerr << "Failed to add image to the atlas\n";
+    InvalidateFrame();
+    return image;
+}
 
-        float xpos = cursorX + fc.xoffset * scale;
-        float ypos = y + fc.yoffset * scale;
-        float w = fc.w * scale;
-        float h = fc.h * scale;
+ImageId Renderer::LoadImageFile(const std::wstring& path)
+{
+    // no context: no mips are generated, the atlas keeps only the top level
+    ID3D11ShaderResourceView* view = nullptr;
+    HRESULT hr = CreateWICTextureFromFile(device, nullptr, path.c_str(), nullptr, &view);
+    if (FAILED(hr)) {
+        std::cerr << "Failed to load image\n";
+        return InvalidImage;
+    }
 
-        DrawChar(xpos, ypos, w, h, fc.u0, fc.v0, fc.u1, fc.v1, color.r, color.g, color.b, color.a);
+    // the read back goes through the context the render thread uses
+    WaitForRenderThread();
 
-        cursorX += fc.xadvance * scale;
+    std::vector<uint32_t> pixels;
+    int width = 0, height = 0;
+    bool read = ReadTexturePixels(view, pixels, width, height);
+    view->Release();
+    if (!read) {
+        std::cerr << "Unsupported image format\n";
+        return InvalidImage;
     }
+    return CreateImage(pixels.data(), width, height);
 }
 
-void Renderer::FlushBatch()
+Vec2 Renderer::GetImageSize(ImageId image) const
 {
-    size_t count = vertexBufferData.size();
-    if (count == 0) return;
+    AtlasRegion region = atlas->GetRegion(image);
+    return { (float)region.width, (float)region.height };
+}
 
-    EnsureBufferSize(count);
+DynamicTexture* Renderer::CreateDynamicTexture(int width, int height)
+{
+    DynamicTextureEntry entry;
+    entry.device = std::make_unique<D3D11StagingDevice>(device, context);
+    entry.texture = std::make_unique<DynamicTexture>(entry.device.get(), width, height);
+    DynamicTexture* texture = entry.texture.get();
+
+    std::lock_guard<std::mutex> lock(dynamicTexturesMutex);
+    dynamicTextures.push_back(std::move(entry));
+    return texture;
+}
+
+void Renderer::DestroyDynamicTexture(DynamicTexture* texture)
+{
+    // the render thread may still be copying into it
+    WaitForRenderThread();
+
+    std::lock_guard<std::mutex> lock(dynamicTexturesMutex);
+    auto it = std::find_if(dynamicTextures.begin(), dynamicTextures.end(),
+        [texture](const DynamicTextureEntry& entry) { return entry.texture.get() == texture; });
+    if (it != dynamicTextures.end()) dynamicTextures.erase(it);
+}
+
+bool Renderer::HasDirtyDynamicTextures()
+{
+    std::lock_guard<std::mutex> lock(dynamicTexturesMutex);
+    for (const DynamicTextureEntry& entry : dynamicTextures) {
+        if (entry.texture->IsDirty()) return true;
+    }
+    return false;
+}
+
+void Renderer::AddImage(const DynamicTexture* texture, Vec2 topLeft, Vec2 size, const Color& tint)
+{
+    DrawList& list = CurrentList();
+    if (!texture || !texture->GetView()) return;
+
+    Vec2 pts[2] = { topLeft, topLeft + size };
+    if (!list.IsVisible(PointBounds(pts, 2))) return;
+
+    ID3D11ShaderResourceView* prevTexture = list.GetTexture();
+    list.SetTexture(texture->GetView());
+    list.PrimReserve(4, 6);
+    list.PrimRectUV(topLeft, topLeft + size, { 0.f, 0.f }, { 1.f, 1.f }, tint.ToRGBA8());
+    list.SetTexture(prevTexture);
+}
+
+ID3D11ShaderResourceView* Renderer::PageTexture(int page) const
+{
+    // the first page is what commands without a texture are drawn with
+    return page == 0 ? nullptr : atlas->GetPageTexture(page);
+}
+
+void Renderer::AddImage(ImageId image, Vec2 topLeft, Vec2 size, const Color& tint)
+{
+    DrawList& list = CurrentList();
+    AtlasRegion region = atlas->GetRegion(image);
+    if (region.page < 0) return;
+
+    Vec2 pts[2] = { topLeft, topLeft + size };
+    if (!list.IsVisible(PointBounds(pts, 2))) return;
+
+    ID3D11ShaderResourceView* prevTexture = list.GetTexture();
+    list.SetTexture(PageTexture(region.page));
+    list.PrimReserve(4, 6);
+    list.PrimRectUV(topLeft, topLeft + size, region.uvMin, region.uvMax, tint.ToRGBA8());
+    list.SetTexture(prevTexture);
+}
+
+void Renderer::AddImageRounded(ImageId image, Vec2 topLeft, Vec2 size, float rounding, const Color& tint)
+{
+    DrawList& list = CurrentList();
+    float radius = std::min({ rounding, std::fabs(size.x) * 0.5f, std::fabs(size.y) * 0.5f });
+    if (radius < 0.5f) {
+        AddImage(image, topLeft, size, tint);
+        return;
+    }
+
+    AtlasRegion region = atlas->GetRegion(image);
+    if (region.page < 0) return;
+
+    float left = std::min(topLeft.x, topLeft.x + size.x), right = std::max(topLeft.x, topLeft.x + size.x);
+    float top = std::min(topLeft.y, topLeft.y + size.y), bottom = std::max(topLeft.y, topLeft.y + size.y);
+    if (!list.IsVisible({ left, top, right, bottom })) return;
+
+    // outline clockwise from the top-left corner, one quarter of the unit
+    // circle per corner so the corners match AddCircle of the same radius
+    int n = circleTable.SegmentCount(radius);
+    int quarter = n / 4;
+    const Vec2* unit = circleTable.UnitCircle(n);
+    const Vec2 centers[4] = {
+        { left + radius, top + radius }, { right - radius, top + radius },
+        { right - radius, bottom - radius }, { left + radius, bottom - radius },
+    };
+    const int startIndex[4] = { 2 * quarter, 3 * quarter, 0, quarter };
+
+    std::vector<Vec2>& pts = list.tempPoints;
+    pts.clear();
+    for (int c = 0; c < 4; c++) {
+        for (int i = 0; i <= quarter; i++) {
+            const Vec2& u = unit[(startIndex[c] + i) % n];
+            pts.push_back({ centers[c].x + u.x * radius, centers[c].y + u.y * radius });
+        }
+    }
+
+    // uv follows the position linearly, like the quad of AddImage
+    float du = (region.uvMax.x - region.uvMin.x) / size.x;
+    float dv = (region.uvMax.y - region.uvMin.y) / size.y;
+    uint32_t col = tint.ToRGBA8();
+    int count = (int)pts.size();
+
+    ID3D11ShaderResourceView* prevTexture = list.GetTexture();
+    list.SetTexture(PageTexture(region.page));
+    list.PrimReserve(count, (count - 2) * 3);
+    DrawIndex base = list.vtxCurrentIdx;
+    for (const Vec2& p : pts) {
+        float u = region.uvMin.x + (p.x - topLeft.x) * du;
+        float v = region.uvMin.y + (p.y - topLeft.y) * dv;
+        list.PrimWriteVtx(p.x, p.y, PackUnorm16(u), PackUnorm16(v), col);
+    }
+    for (int i = 1; i < count - 1; i++) {
+        list.PrimWriteIdx(base);
+        list.PrimWriteIdx(base + i);
+        list.PrimWriteIdx(base + i + 1);
+    }
+    list.SetTexture(prevTexture);
+}
+
+// Copies the top level of a texture back to the CPU as RGBA8. Only 8-bit
+// RGBA/BGRA textures are taken, that is what WIC gives for usual image files.
+bool Renderer::ReadTexturePixels(ID3D11ShaderResourceView* view, std::vector<uint32_t>& pixels, int& width, int& height)
+{
+    ID3D11Resource* resource = nullptr;
+    view->GetResource(&resource);
+    ID3D11Texture2D* texture = nullptr;
+    HRESULT hr = resource->QueryInterface(&texture);
+    resource->Release();
+    if (FAILED(hr)) return false;
+
+    D3D11_TEXTURE2D_DESC desc;
+    texture->GetDesc(&desc);
+    bool bgra = desc.Format == DXGI_FORMAT_B8G8R8A8_UNORM || desc.Format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+    bool rgba = desc.Format == DXGI_FORMAT_R8G8B8A8_UNORM || desc.Format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    if (!bgra && !rgba) {
+        texture->Release();
+        return false;
+    }
+
+    D3D11_TEXTURE2D_DESC stagingDesc = desc;
+    stagingDesc.MipLevels = 1;
+    stagingDesc.ArraySize = 1;
+    stagingDesc.Usage = D3D11_USAGE_STAGING;
+    stagingDesc.BindFlags = 0;
+    stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    stagingDesc.MiscFlags = 0;
+
+    ID3D11Texture2D* staging = nullptr;
+    hr = device->CreateTexture2D(&stagingDesc, nullptr, &staging);
+    if (FAILED(hr)) {
+        texture->Release();
+        return false;
+    }
+    context->CopySubresourceRegion(staging, 0, 0, 0, 0, texture, 0, nullptr);
+    texture->Release();
 
     D3D11_MAPPED_SUBRESOURCE mapped = {};
-    HRESULT hr = context->Map(gpuVertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
-    if (FAILED(hr)) return;
+    hr = context->Map(staging, 0, D3D11_MAP_READ, 0, &mapped);
+    if (FAILED(hr)) {
+        staging->Release();
+        return false;
+    }
+
+    width = (int)desc.Width;
+    height = (int)desc.Height;
+    pixels.resize((size_t)width * height);
+    for (int y = 0; y < height; y++) {
+        const uint32_t* src = (const uint32_t*)((const uint8_t*)mapped.pData + (size_t)y * mapped.RowPitch);
+        uint32_t* dst = &pixels[(size_t)y * width];
+        if (rgba) {
+            memcpy(dst, src, width * sizeof(uint32_t));
+            continue;
+        }
+        for (int x = 0; x < width; x++) {
+            uint32_t p = src[x];
+            dst[x] = (p & 0xff00ff00u) | ((p >> 16) & 0xffu) | ((p & 0xffu) << 16);
+        }
+    }
+
+    context->Unmap(staging, 0);
+    staging->Release();
+    return true;
+}
+
+// Rect in pixels -> scissor, clamped to the window (the unbounded clip does
+// not fit in a LONG)
+static D3D11_RECT ToScissor(const Rect& r, int width, int height)
+{
+    D3D11_RECT scissor;
+    scissor.left = (LONG)std::floor(std::max(r.left, 0.f));
+    scissor.top = (LONG)std::floor(std::max(r.top, 0.f));
+    scissor.right = (LONG)std::ceil(std::min(r.right, (float)width));
+    scissor.bottom = (LONG)std::ceil(std::min(r.bottom, (float)height));
+    return scissor;
+}
 
-    memcpy(mapped.pData, vertexBufferData.data(), count * sizeof(Vertex));
-    context->Unmap(gpuVertexBuffer, 0);
+// Depth buffer the size of the target, recreated when that changes
+bool Renderer::EnsureDepthBuffer(int width, int height)
+{
+    if (depthView && depthWidth == width && depthHeight == height) return true;
+    if (depthView) { depthView->Release(); depthView = nullptr; }
+    depthWidth = depthHeight = 0;
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = (UINT)width;
+    desc.Height = (UINT)height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_D32_FLOAT;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+
+    ID3D11Texture2D* texture = nullptr;
+    HRESULT hr = device->CreateTexture2D(&desc, nullptr, &texture);
+    if (SUCCEEDED(hr)) {
+        hr = device->CreateDepthStencilView(texture, nullptr, &depthView);
+        texture->Release();
+    }
+    if (FAILED(hr)) {
+        std::cerr << "Failed to create depth buffer\n";
+        return false;
+    }
+
+    depthWidth = width;
+    depthHeight = height;
+    return true;
+}
 
+void Renderer::FlushBatch(const DrawList& list, int width, int height)
+{
+    if (width == 0 || height == 0 || !context) return;
+
+    atlas->Flush();
+    {
+        std::lock_guard<std::mutex> lock(dynamicTexturesMutex);
+        for (DynamicTextureEntry& entry : dynamicTextures) {
+            if (entry.texture->Flush()) damage.InvalidateTexture(entry.texture->GetView());
+        }
+    }
+
+    if (damageInvalidated.exchange(false)) damage.Invalidate();
+    if (drawTarget.partialRedraw) damage.Update(list, width, height);
+
+    // the part of the back buffer that is cleared and redrawn: everything, or
+    // only the damaged rects when the swap chain keeps its contents
+    Rect full = { 0.f, 0.f, (float)width, (float)height };
+    const Rect* regions = &full;
+    size_t regionCount = 1;
+    if (drawTarget.partialRedraw && context1 && !damage.IsFullRedraw()) {
+        regions = damage.GetDirtyRects().data();
+        regionCount = damage.GetDirtyRects().size();
+    }
+    if (regionCount == 0) return;
+
+    ID3D11RenderTargetView* target = drawTarget.renderTarget;
+    bool useDepth = depthPass && target && EnsureDepthBuffer(width, height);
+    if (target) {
+        context->OMSetRenderTargets(1, &target, useDepth ? depthView : nullptr);
+        if (useDepth) context->ClearDepthStencilView(depthView, D3D11_CLEAR_DEPTH, 1.f, 0);
+        const Color& color = drawTarget.clearColor;
+        const float clear[4] = { color.r, color.g, color.b, color.a };
+        if (regions == &full) {
+            context->ClearRenderTargetView(target, clear);
+        }
+        else {
+            D3D11_RECT rects[DamageTracker::MaxRects];
+            for (size_t i = 0; i < regionCount; i++)
+                rects[i] = ToScissor(regions[i], width, height);
+            context1->ClearView(target, clear, rects, (UINT)regionCount);
+        }
+    }
+
+    size_t vtxCount = list.vtxBuffer.size();
+    size_t idxCount = list.idxBuffer.size();
+    size_t instCount = list.instBuffer.size();
+    size_t shapeCount = list.shapeBuffer.size();
+    if (idxCount == 0 && instCount == 0 && shapeCount == 0) return;
+
+    size_t vtxByteOffset = vertexUpload->Upload(list.vtxBuffer.data(), vtxCount * sizeof(Vertex), sizeof(Vertex));
+    size_t idxByteOffset = indexUpload->Upload(list.idxBuffer.data(), idxCount * sizeof(DrawIndex));
+    size_t instByteOffset = instanceUpload->Upload(list.instBuffer.data(), instCount * sizeof(RectInstance), sizeof(RectInstance));
+    size_t shapeByteOffset = shapeUpload->Upload(list.shapeBuffer.data(), shapeCount * sizeof(ShapeInstance), sizeof(ShapeInstance));
+    if (vtxByteOffset == UploadAllocator::Failed || idxByteOffset == UploadAllocator::Failed ||
+        instByteOffset == UploadAllocator::Failed || shapeByteOffset == UploadAllocator::Failed) return;
+
+    // the only place the window size enters the geometry
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    HRESULT hr = context->Map(projectionBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+    if (FAILED(hr)) return;
+    ProjectionConstants* projection = (ProjectionConstants*)mapped.pData;
+    projection->scale[0] = 2.0f / width;
+    projection->scale[1] = -2.0f / height;
+    projection->translate[0] = -1.0f;
+    projection->translate[1] = 1.0f;
+    context->Unmap(projectionBuffer, 0);
+
+    ID3D11Buffer* vertexBuffer = vertexStream->GetBuffer();
     UINT stride = sizeof(Vertex);
-    UINT offset = 0;
+    UINT offset = (UINT)vtxByteOffset;
+    ID3D11Buffer* instanceBuffer = instanceStream->GetBuffer();
+    UINT instanceStride = sizeof(RectInstance);
+    UINT instanceOffset = (UINT)instByteOffset;
+    ID3D11Buffer* shapeBuffer = shapeStream->GetBuffer();
+    UINT shapeStride = sizeof(ShapeInstance);
+    UINT shapeOffset = (UINT)shapeByteOffset;
     context->IASetInputLayout(inputLayout);
-    context->IASetVertexBuffers(0, 1, &gpuVertexBuffer, &stride, &offset);
+    context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+    context->IASetIndexBuffer(indexStream->GetBuffer(), sizeof(DrawIndex) == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, (UINT)idxByteOffset);
     context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
+    D3D11_VIEWPORT vp{};
+    vp.Width = static_cast<FLOAT>(width);
+    vp.Height = static_cast<FLOAT>(height);
+    vp.MinDepth = 0.f;
+    vp.MaxDepth = 1.f;
+    context->RSSetViewports(1, &vp);
+
     context->VSSetShader(vertexShader, nullptr, 0);
+    context->VSSetConstantBuffers(0, 1, &projectionBuffer);
     context->PSSetShader(pixelShader, nullptr, 0);
 
-    context->PSSetShaderResources(0, 1, &fontTextureView);
     context->PSSetSamplers(0, 1, &fontSampler);
 
     // alpha blending
     float blendFactor[4] = { 0,0,0,0 };
     context->OMSetBlendState(alphaBlendState, blendFactor, 0xffffffff);
+    context->RSSetState(rasterizerState);
+
+    // Draw commands in order, each one addresses its own 16-bit vertex range.
+    // With several regions the commands are replayed per region, scissored to
+    // it. The depth pass reorders them, see DepthOrder.
+    if (useDepth) depthOrder.Build(list);
+    // commands without a texture use the first atlas page, its origin is white
+    ID3D11ShaderResourceView* defaultTexture = atlas->GetPageTexture(0);
+    if (!defaultTexture) defaultTexture = whiteTextureView;
+
+    ID3D11ShaderResourceView* boundTexture = nullptr;
+    D3D11_RECT boundScissor = { -1, -1, -1, -1 };
+    float boundDepth = -1.f;
+    enum class Stream { Indexed, Rects, Shapes };
+    Stream boundStream = Stream::Indexed;
+    auto drawCommand = [&](const DrawCommand& cmd, const Rect& region, float depth) {
+        if (cmd.IsEmpty()) return;
+
+        D3D11_RECT scissor = ToScissor(cmd.clipRect.Intersect(region), width, height);
+        if (scissor.right <= scissor.left || scissor.bottom <= scissor.top) return;
+        if (scissor.left != boundScissor.left || scissor.top != boundScissor.top ||
+            scissor.right != boundScissor.right || scissor.bottom != boundScissor.bottom) {
+            context->RSSetScissorRects(1, &scissor);
+            boundScissor = scissor;
+        }
 
-    // Draw all vertices in order
-    context->Draw((UINT)count, 0);
-
-    vertexBufferData.clear();
+        // the viewport squeezes the z of 0 every shader writes to the depth
+        // of the command, no per-vertex depth needed
+        if (useDepth && depth != boundDepth) {
+            vp.MinDepth = depth;
+            vp.MaxDepth = depth;
+            context->RSSetViewports(1, &vp);
+            boundDepth = depth;
+        }
 
-    ID3D11ShaderResourceView* nullSRV[1] = { nullptr };
-    context->PSSetShaderResources(0, 1, nullSRV);
-}
+        ID3D11ShaderResourceView* texture = cmd.texture ? cmd.texture : defaultTexture;
+        if (texture != boundTexture) {
+            context->PSSetShaderResources(0, 1, &texture);
+            boundTexture = texture;
+        }
 
-void Renderer::EnsureBufferSize(size_t required)
-{
-    if (required <= gpuBufferCapacity) return;
+        // indexed and instanced commands feed the input stage differently,
+        // shapes also have their own pixel shader
+        Stream stream = cmd.instCount == 0 ? Stream::Indexed : cmd.shapeInstances ? Stream::Shapes : Stream::Rects;
+        if (stream != boundStream) {
+            if (stream == Stream::Rects) {
+                context->IASetInputLayout(instanceInputLayout);
+                context->IASetVertexBuffers(0, 1, &instanceBuffer, &instanceStride, &instanceOffset);
+                context->VSSetShader(instanceVertexShader, nullptr, 0);
+            }
+            else if (stream == Stream::Shapes) {
+                context->IASetInputLayout(shapeInputLayout);
+                context->IASetVertexBuffers(0, 1, &shapeBuffer, &shapeStride, &shapeOffset);
+                context->VSSetShader(shapeVertexShader, nullptr, 0);
+            }
+            else {
+                context->IASetInputLayout(inputLayout);
+                context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+                context->VSSetShader(vertexShader, nullptr, 0);
+            }
+            if ((stream == Stream::Shapes) != (boundStream == Stream::Shapes))
+                context->PSSetShader(stream == Stream::Shapes ? shapePixelShader : pixelShader, nullptr, 0);
+            boundStream = stream;
+        }
 
-    if (gpuVertexBuffer) gpuVertexBuffer->Release();
+        if (stream != Stream::Indexed)
+            context->DrawInstanced(cmd.instVertexCount, cmd.instCount, 0, cmd.instOffset);
+        else
+            context->DrawIndexed(cmd.elemCount, cmd.idxOffset, (INT)cmd.vtxOffset);
+    };
 
-    D3D11_BUFFER_DESC desc = {};
-    desc.Usage = D3D11_USAGE_DYNAMIC;
-    desc.ByteWidth = (UINT)(required * sizeof(Vertex));
-    desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    for (size_t r = 0; r < regionCount; r++) {
+        if (!useDepth) {
+            for (const DrawCommand& cmd : list.cmdBuffer) drawCommand(cmd, regions[r], 0.f);
+            continue;
+        }
 
-    HRESULT hr = device->CreateBuffer(&desc, nullptr, &gpuVertexBuffer);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to grow GPU buffer\n";
-        return;
+        // opaque front to back writing depth, then the rest in painter's order
+        context->OMSetDepthStencilState(depthWriteState, 0);
+        for (const DepthRun& run : depthOrder.GetOpaque()) drawCommand(DepthOrder::Slice(list, run), regions[r], run.depth);
+        context->OMSetDepthStencilState(depthTestState, 0);
+        for (const DepthRun& run : depthOrder.GetTranslucent()) drawCommand(DepthOrder::Slice(list, run), regions[r], run.depth);
     }
+    if (useDepth) context->OMSetDepthStencilState(nullptr, 0);
 
-    gpuBufferCapacity = required;
+    ID3D11ShaderResourceView* nullSRV[1] = { nullptr };
+    context->PSSetShaderResources(0, 1, nullSRV);
 }
 
 bool Renderer::LoadFontMap(const std::string& path) {
@@ -448,13 +1816,184 @@ bool Renderer::LoadFontMap(const std::string& path) {
         }
     }
 
+    // flat lookup for AddText, ids outside a byte are never produced by it
+    for (auto& glyph : glyphs) glyph = nullptr;
+    for (auto& [id, fc] : fontMap) {
+        if (id >= 0 && id < 256) glyphs[id] = &fc;
+    }
+
     std::cout << "[Font] Loaded " << fontMap.size() << " characters\n";
     return true;
 }
 
 void Renderer::End() {
+    drawList.SetChannel(DefaultChannel);
+    MergeThreadLists();
+    // geometry drawn outside the UI windows is hashed as it is, before the
+    // windows are added, so the cost follows that geometry only
+    directHash = drawList.ComputeHash();
     ui->End();
-    FlushBatch();
+    drawList.MergeChannels();
+
+    // same picture and same input as last frame: the swap chain already shows it
+    if (HasDirtyDynamicTextures()) frameInvalidated = true;
+    uint64_t fingerprint = FrameFingerprint();
+    frameElided = frameElision && !frameInvalidated && fingerprint == lastFingerprint;
+    lastFingerprint = fingerprint;
+    frameInvalidated = false;
+    if (frameElided) {
+        elidedFrames++;
+        return;
+    }
+
+    if (renderThread)
+        renderThread->Submit(drawList, windowWidth, windowHeight);
+    else {
+        backend->CaptureFrameState();
+        backend->RenderFrame(drawList, windowWidth, windowHeight);
+    }
+}
+
+void Renderer::BeginBlock(DrawBlock& block)
+{
+    block.resumeList = threadTarget.owner == this ? threadTarget.list : nullptr;
+    block.list.Clear();
+    SetTargetList(&block.list);
+}
+
+void Renderer::EndBlock(DrawBlock& block)
+{
+    block.list.SetChannel(DefaultChannel);
+    block.bounds = block.list.ComputeBounds();
+    SetTargetList(block.resumeList);
+    block.resumeList = nullptr;
+}
+
+void Renderer::AddBlock(const DrawBlock& block)
+{
+    DrawList& list = CurrentList();
+    if (block.IsEmpty()) return;
+
+    // a pixel of slack for edges that reach past the vertices
+    const DrawTransform& transform = list.GetTransform();
+    Rect bounds = transform.Apply(block.bounds);
+    if (!list.IsVisible({ bounds.left - 1.f, bounds.top - 1.f, bounds.right + 1.f, bounds.bottom + 1.f })) return;
+
+    list.AppendTransformed(block.list, transform);
+}
+
+void Renderer::SetThreadedRendering(bool enabled)
+{
+    if (enabled == (renderThread != nullptr)) return;
+
+    if (enabled)
+        renderThread = std::make_unique<RenderThread>(backend);
+    else
+        renderThread.reset();
+}
+
+void Renderer::SetBackend(RenderBackend* newBackend)
+{
+    // the thread finishes the frame in flight on the old backend first
+    bool threaded = renderThread != nullptr;
+    renderThread.reset();
+
+    backend = newBackend ? newBackend : &d3dBackend;
+    if (threaded) renderThread = std::make_unique<RenderThread>(backend);
+}
+
+void Renderer::WaitForRenderThread()
+{
+    if (renderThread) renderThread->WaitIdle();
+}
+
+Renderer::ThreadList* Renderer::AcquireThreadList()
+{
+    if (threadListCache.owner == instanceId) return threadListCache.node;
+
+    // first recording on this thread
+    std::lock_guard<std::mutex> lock(threadListsMutex);
+    threadLists.push_back(std::make_unique<ThreadList>());
+    threadListCache = { instanceId, threadLists.back().get() };
+    return threadListCache.node;
+}
+
+void Renderer::BeginThreadRecording(int layer)
+{
+    ThreadList* node = AcquireThreadList();
+    if (node->frame != frameIndex.load(std::memory_order_acquire)) {
+        float width = (float)frameWidth.load(std::memory_order_relaxed);
+        float height = (float)frameHeight.load(std::memory_order_relaxed);
+        node->list.Clear();
+        node->list.PushClipRect({ 0.f, 0.f, width, height }, false);
+        node->layer = layer;
+    }
+    SetTargetList(&node->list);
+}
+
+void Renderer::EndThreadRecording()
+{
+    SetTargetList(nullptr);
+
+    ThreadList* node = AcquireThreadList();
+    uint64_t frame = frameIndex.load(std::memory_order_acquire);
+    if (node->frame == frame) return;       // already handed over this frame
+    node->frame = frame;
+
+    ThreadList* head = submittedLists.load(std::memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!submittedLists.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void Renderer::MergeThreadLists()
+{
+    ThreadList* head = submittedLists.exchange(nullptr, std::memory_order_acquire);
+    if (!head) return;
+
+    mergeOrder.clear();
+    for (ThreadList* node = head; node; node = node->next)
+        mergeOrder.push_back(node);
+    std::reverse(mergeOrder.begin(), mergeOrder.end());
+    std::stable_sort(mergeOrder.begin(), mergeOrder.end(),
+        [](const ThreadList* a, const ThreadList* b) { return a->layer < b->layer; });
+
+    // what this thread drew so far goes between the negative and the other layers
+    std::swap(drawList, mergeScratch);
+    drawList.Clear();
+    drawList.PushClipRect({ 0.f, 0.f, (float)windowWidth, (float)windowHeight }, false);
+
+    size_t i = 0;
+    for (; i < mergeOrder.size() && mergeOrder[i]->layer < 0; i++)
+        drawList.Append(mergeOrder[i]->list, { 0.f, 0.f });
+    drawList.Append(mergeScratch, { 0.f, 0.f });
+    for (; i < mergeOrder.size(); i++)
+        drawList.Append(mergeOrder[i]->list, { 0.f, 0.f });
+}
+
+// Stands in for the frame's content: the windows are known by their content
+// hashes, only the geometry drawn outside them is hashed in full
+uint64_t Renderer::FrameFingerprint() const
+{
+    int size[2] = { windowWidth, windowHeight };
+    uint64_t hash = HashValue(size);
+    hash = HashValue(ui->GetContentHash(), hash);
+    hash = HashValue(directHash, hash);
+
+    const Ui::Context& input = *ui->GetContext();
+    hash = HashValue(input.mousePos, hash);
+    bool keys[8] = { input.mouseDown, input.mousePrevDown, input.mouseClicked, input.mouseReleased,
+                     input.keyBackspace, input.keyEnter, input.keyLeft, input.keyRight };
+    hash = HashValue(keys, hash);
+    return HashString(input.textInput, hash);
+}
+
+void Renderer::SetUploadMode(UploadAllocator::Mode mode)
+{
+    vertexUpload->SetMode(mode);
+    indexUpload->SetMode(mode);
+    instanceUpload->SetMode(mode);
+    shapeUpload->SetMode(mode);
 }
 
 Renderer::Ui::Ui(Renderer* r) : renderer(r) {}
@@ -535,26 +2074,158 @@ void Renderer::Ui::End() {
 
 
 
-    // Draw All windows
+    ComputeOcclusion();
+
+    // Draw All windows: rebuild the ones whose content changed, each into its
+    // own list and spread over the worker pool when there are several, then
+    // splice every list in z-order. Moved windows only get an offset, and the
+    // frame comes out byte-identical to a serial build.
+    rebuiltWindows = 0;
+    cachedWindows = 0;
+    rebuildQueue.clear();
     for (auto& win : windows) {
+        if (!win->visible || win->occluded) continue;
+
+        uint64_t hash = WindowHash(*win);
+        if (hash == Component::Uncached || hash != win->drawHash) {
+            win->drawHash = hash;
+            rebuildQueue.push_back(win.get());
+            rebuiltWindows++;
+        }
+        else {
+            cachedWindows++;
+        }
+    }
+
+    if (parallelBuild && rebuildQueue.size() > 1) {
+        if (!workers) workers = std::make_unique<WorkerPool>();
+        workers->ParallelFor((int)rebuildQueue.size(), [this](int i) { BuildWindow(*rebuildQueue[i]); });
+    }
+    else {
+        for (Window* win : rebuildQueue) BuildWindow(*win);
+    }
+
+    contentHash = HashSeed;
+    for (auto& win : windows) {
+        if (!win->visible || win->occluded) continue;
+        renderer->drawList.Append(win->drawList, { win->x - win->drawPos.x, win->y - win->drawPos.y });
+
+        uint64_t content = win->drawHash == Component::Uncached ? ++uncachedBuilds : win->drawHash;
+        float pos[2] = { win->x, win->y };
+        contentHash = HashValue(pos, HashValue(content, contentHash));
+    }
+
+    currentWindow = nullptr;
+}
+
+void Renderer::Ui::InvalidateCaches() {
+    for (auto& win : windows) win->drawHash = Component::Uncached;
+}
+
+// Front to back over the windows: a window whose frame is covered by the
+// opaque windows in front of it is skipped entirely, and so is any component
+// of a partly covered one whose bounds are. Windows are opaque when their
+// background colour is.
+void Renderer::Ui::ComputeOcclusion() {
+    occludedWindows = 0;
+    culledComponents = 0;
+    coverRects.clear();
+    bool opaque = UserInterfaceColors::WindowBackground.a >= 1.f;
+
+    for (auto it = windows.rbegin(); it != windows.rend(); ++it) {
+        Window* win = it->get();
         if (!win->visible) continue;
 
-        // Background
-        renderer->AddRectangleFilled({ win->x, win->y }, { win->w, win->h }, UserInterfaceColors::WindowBackground);
-        // Titlebar
-        renderer->AddRectangleFilled({ win->x, win->y }, { win->w, UserInterfaceStyles::WindowTitleHeight }, UserInterfaceColors::WindowTitlebar);
-        // Background Border
-        renderer->AddRectangle({ win->x, win->y }, { win->w, win->h }, UserInterfaceColors::WindowBorder);
-        // Title
-        renderer->AddText(win->x + 5, win->y + 5, win->title, UserInterfaceColors::TextColor);
+        // the border straddles the window edge
+        Rect frame = { win->x - 1.f, win->y - 1.f, win->x + win->w + 1.f, win->y + win->h + 1.f };
+        win->occluded = !coverRects.empty() && IsCovered(frame);
+        if (win->occluded) {
+            occludedWindows++;
+            continue;
+        }
 
-        // Update and draw all components relative to window
+        float contentTop = win->y + UserInterfaceStyles::WindowTitleHeight;
+        Rect content = { win->x, contentTop, win->x + win->w, win->y + win->h };
         for (auto& comp : win->components) {
-            comp->Draw(renderer, win->x, win->y + UserInterfaceStyles::WindowTitleHeight);
+            comp->culled = !coverRects.empty() && IsCovered(comp->GetBounds(renderer, win->x, contentTop).Intersect(content));
+            if (comp->culled) culledComponents++;
         }
+
+        if (opaque) coverRects.push_back({ win->x, win->y, win->x + win->w, win->y + win->h });
     }
+}
 
-    currentWindow = nullptr;
+// Subtracts every cover rect from r, true when nothing is left
+bool Renderer::Ui::IsCovered(const Rect& r) {
+    if (r.IsEmpty()) return true;
+
+    coverPieces.assign(1, r);
+    for (const Rect& c : coverRects) {
+        coverNext.clear();
+        for (const Rect& p : coverPieces) {
+            if (!p.Overlaps(c)) {
+                coverNext.push_back(p);
+                continue;
+            }
+            float top = std::max(p.top, c.top);
+            float bottom = std::min(p.bottom, c.bottom);
+            if (c.top > p.top) coverNext.push_back({ p.left, p.top, p.right, c.top });
+            if (c.bottom < p.bottom) coverNext.push_back({ p.left, c.bottom, p.right, p.bottom });
+            if (c.left > p.left) coverNext.push_back({ p.left, top, c.left, bottom });
+            if (c.right < p.right) coverNext.push_back({ c.right, top, p.right, bottom });
+        }
+        std::swap(coverPieces, coverNext);
+        if (coverPieces.empty()) return true;
+
+        // pathological layouts: give up rather than fragment further
+        if (coverPieces.size() > 256) return false;
+    }
+    return false;
+}
+
+// Everything a window's geometry depends on except its position
+uint64_t Renderer::Ui::WindowHash(const Window& win) const {
+    float size[2] = { win.w, win.h };
+    uint64_t hash = HashValue(size, HashString(win.title));
+
+    for (auto& comp : win.components) {
+        uint64_t compHash = comp->Hash();
+        if (compHash == Component::Uncached) return Component::Uncached;
+        hash = HashValue(compHash, hash);
+        hash = HashValue(comp->culled, hash);
+    }
+    return hash == Component::Uncached ? 1 : hash;
+}
+
+void Renderer::Ui::BuildWindow(Window& win) {
+    // window lists have no viewport clip, a window dragged in from off screen
+    // is spliced in with everything it had
+    win.drawList.Clear();
+    win.drawPos = { win.x, win.y };
+    renderer->SetTargetList(&win.drawList);
+
+    // Background
+    renderer->AddRectangleFilled({ win.x, win.y }, { win.w, win.h }, UserInterfaceColors::WindowBackground);
+    // Titlebar
+    renderer->AddRectangleFilled({ win.x, win.y }, { win.w, UserInterfaceStyles::WindowTitleHeight }, UserInterfaceColors::WindowTitlebar);
+    // Background Border
+    renderer->AddRectangle({ win.x, win.y }, { win.w, win.h }, UserInterfaceColors::WindowBorder);
+
+    float contentTop = win.y + UserInterfaceStyles::WindowTitleHeight;
+
+    // Title, kept inside the titlebar
+    renderer->PushClipRect({ win.x, win.y, win.x + win.w, contentTop });
+    renderer->AddText(win.x + 5, win.y + 5, win.title, UserInterfaceColors::TextColor);
+    renderer->PopClipRect();
+
+    // Draw all components relative to window, clipped to its content area
+    renderer->PushClipRect({ win.x, contentTop, win.x + win.w, win.y + win.h });
+    for (auto& comp : win.components) {
+        if (!comp->culled) comp->Draw(renderer, win.x, contentTop);
+    }
+    renderer->PopClipRect();
+
+    renderer->SetTargetList(nullptr);
 }
 
 // ----------------------------
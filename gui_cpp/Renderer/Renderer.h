@@ -1,18 +1,37 @@
 #pragma once
 #include <d3d11.h>
+#include <d3d11_1.h>
 #include <vector>
 #include <unordered_map>
 #include <Windows.h>
 #include <string>
 #include <functional>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <span>
 
 #include "RendererPrimitives.h"
 #include "RendererStyles.h"
+#include "DrawList.h"
+#include "DrawBlock.h"
+#include "UploadAllocator.h"
+#include "CircleTable.h"
+#include "Hash.h"
+#include "DamageTracker.h"
+#include "DepthOrder.h"
+#include "BulkKernels.h"
+#include "WorkerPool.h"
+#include "RenderBackend.h"
+#include "RenderThread.h"
+#include "TextureAtlas.h"
+#include "DynamicTexture.h"
 #include "Texture/WICTextureLoader.h"
 
 class Renderer {
 public:
+    // Without a device the renderer is headless: frames are recorded as usual
+    // but only reach a backend set with SetBackend, and no input is polled
     Renderer(ID3D11Device* device, ID3D11DeviceContext* context);
     ~Renderer();
 
@@ -22,13 +41,125 @@ public:
 
     // basic drawing
     void AddTriangle(Vec2 a, Vec2 b, Vec2 c, const Color& color);
+    void AddQuadFilled(Vec2 a, Vec2 b, Vec2 c, Vec2 d, const Color& color);
     void AddLine(Vec2 a, Vec2 b, const Color& color, float thickness);
+    void AddPolyline(const Vec2* points, int count, const Color& color, bool closed, float thickness = 1.f);
+    void AddConvexPolyFilled(const Vec2* points, int count, const Color& color);
+    void AddConcavePolyFilled(const Vec2* points, int count, const Color& color);
     void AddRectangle(Vec2 topLeft, Vec2 size, const Color& color, float thickness = 1.f);
-    void AddRectangleFilled(Vec2 topLeft, Vec2 size, const Color& color);
-    void AddCircle(Vec2 center, float radius, const Color& color, float thickness = 1.f, int segments = 32);
-    void AddCircleFilled(Vec2 center, float radius, const Color& color, int segments = 32);
+    void AddRectangleFilled(Vec2 topLeft, Vec2 size, const Color& color, float rounding = 0.f);
+    void AddCircle(Vec2 center, float radius, const Color& color, float thickness = 1.f, int segments = 0);       // segments = 0: from radius
+    void AddCircleFilled(Vec2 center, float radius, const Color& color, int segments = 0);                         // segments = 0: from radius
+    void AddBezierQuadratic(Vec2 p1, Vec2 p2, Vec2 p3, const Color& color, float thickness = 1.f, int segments = 0);          // segments = 0: from curvature
+    void AddBezierCubic(Vec2 p1, Vec2 p2, Vec2 p3, Vec2 p4, const Color& color, float thickness = 1.f, int segments = 0);
     void AddText(float x, float y, const std::string& text, const Color& color, float scale = 1.f);
 
+    // Analytic shapes: one quad each, the pixel shader computes how much of
+    // every pixel is covered, so edges are anti-aliased whatever the size.
+    // thickness = 0 fills the rounded rect, otherwise only a band that wide
+    // inside its edge is drawn. AddRing covers innerRadius..outerRadius,
+    // AddCircleAnalytic is the AddCircle/AddCircleFilled of these: thickness
+    // = 0 fills, otherwise a band that wide is centred on the radius.
+    void AddRectRounded(Vec2 topLeft, Vec2 size, const Color& color, float rounding, float thickness = 0.f);
+    void AddRing(Vec2 center, float innerRadius, float outerRadius, const Color& color);
+    void AddCircleAnalytic(Vec2 center, float radius, const Color& color, float thickness = 0.f);
+
+    // Bulk drawing: many primitives per call, expanded by SIMD kernels into
+    // the same vertices and indices the single Add* calls write. colors holds
+    // one packed RGBA8 colour per primitive or a single one shared by all,
+    // primitives past the end of a longer colors span are ignored.
+    void AddRectsFilled(std::span<const Rect> rects, std::span<const uint32_t> colors);
+    void AddPoints(std::span<const Vec2> points, std::span<const uint32_t> colors, float size = 1.f);     // size x size squares
+    void AddLines(std::span<const Vec2> endpoints, std::span<const uint32_t> colors, float thickness = 1.f);  // pairs of endpoints
+    void AddCirclesFilled(std::span<const Vec2> centers, std::span<const float> radii, std::span<const uint32_t> colors);  // analytic, like AddCircleAnalytic
+    // Kernels the bulk calls use, DetectSimdLevel() by default. Lowering it is
+    // for comparisons, a level the CPU lacks falls back to the detected one.
+    void SetSimdLevel(SimdLevel level) { simdLevel = level < DetectSimdLevel() ? level : DetectSimdLevel(); }
+    SimdLevel GetSimdLevel() const { return simdLevel; }
+    Vec2 MeasureText(const std::string& text, float scale = 1.f) const;      // advance width, height below y
+
+    // Images are copied into the texture atlas. Images, text and flat
+    // geometry that end up on the same atlas page are drawn in one call,
+    // everything that fits the first page always is. Pixels are RGBA8 with r
+    // in the low byte, like Color::ToRGBA8. LoadImageFile takes any format
+    // WIC decodes and must be called from the thread that calls End().
+    ImageId CreateImage(const uint32_t* pixels, int width, int height);
+    ImageId LoadImageFile(const std::wstring& path);
+    Vec2 GetImageSize(ImageId image) const;
+    void AddImage(ImageId image, Vec2 topLeft, Vec2 size, const Color& tint = Color(1.f, 1.f, 1.f, 1.f));
+    void AddImageRounded(ImageId image, Vec2 topLeft, Vec2 size, float rounding, const Color& tint = Color(1.f, 1.f, 1.f, 1.f));
+    const TextureAtlas& GetAtlas() const { return *atlas; }
+
+    // Textures the CPU keeps rewriting (camera frames, heatmaps). Update them
+    // through DynamicTexture from any thread, the changed block is uploaded
+    // when the next frame is drawn and keeps that frame from being elided.
+    // Don't destroy a texture that is drawn in the current frame.
+    DynamicTexture* CreateDynamicTexture(int width, int height);
+    void DestroyDynamicTexture(DynamicTexture* texture);
+    void AddImage(const DynamicTexture* texture, Vec2 topLeft, Vec2 size, const Color& tint = Color(1.f, 1.f, 1.f, 1.f));
+
+    // paths: build a point list, then stroke or fill it (the path is cleared afterwards)
+    void PathClear() { CurrentList().path.clear(); }
+    void PathLineTo(Vec2 p) { CurrentList().path.push_back(p); }
+    void PathArcTo(Vec2 center, float radius, float aMin, float aMax, int segments = 0);   // angles in radians, clockwise on screen
+    void PathBezierQuadraticTo(Vec2 p2, Vec2 p3, int segments = 0);          // starts at the last path point
+    void PathBezierCubicTo(Vec2 p2, Vec2 p3, Vec2 p4, int segments = 0);
+    void PathStroke(const Color& color, bool closed = false, float thickness = 1.f);
+    void PathFillConvex(const Color& color);
+    void PathFillConcave(const Color& color);      // simple polygons of any shape
+
+    // Recording from other threads: between Begin() and End() any thread can
+    // call BeginThreadRecording, issue Add*/Path* calls and finish with
+    // EndThreadRecording. Every thread records into its own list without
+    // locking and hands it over with one atomic push. End() merges the lists
+    // by layer, lower first and equal layers in hand-over order: negative
+    // layers go below what the End() thread drew itself, the rest above it,
+    // all below the UI windows. Layers order lists within a draw channel.
+    // Recording again in the same frame continues the thread's list and
+    // keeps its first layer.
+    void BeginThreadRecording(int layer = 0);
+    void EndThreadRecording();
+
+    // Static geometry: between BeginBlock and EndBlock the Add*/Path* calls
+    // of the calling thread record into the block instead of the frame,
+    // replacing what it held. AddBlock replays it into the current list
+    // under the current transform, a copy of the finished geometry, and
+    // skips it when its transformed bounds are clipped away. Blocks can be
+    // recorded at any time, also outside Begin/End.
+    void BeginBlock(DrawBlock& block);
+    void EndBlock(DrawBlock& block);
+    void AddBlock(const DrawBlock& block);
+
+    // translate-scale transform for AddBlock, pushes compose
+    void PushTransform(Vec2 translate, float scale = 1.f) { CurrentList().PushTransform({ translate, scale }); }
+    void PopTransform() { CurrentList().PopTransform(); }
+
+    // Draw channels of the list the calling thread records into: channels
+    // are drawn lowest first whatever order they were filled in, so a
+    // background can be added after its foreground and overlays stay on top.
+    // UI windows go into DefaultChannel, End() merges all channels once.
+    void SetChannel(int channel) { CurrentList().SetChannel(channel); }
+    int GetChannel() { return CurrentList().GetChannel(); }
+
+    // clipping: primitives entirely outside the current rect are dropped, the rest is scissored
+    void PushClipRect(const Rect& rect, bool intersectWithCurrent = true) { CurrentList().PushClipRect(rect, intersectWithCurrent); }
+    void PopClipRect() { CurrentList().PopClipRect(); }
+
+    // Filled rects as 24-byte instances expanded in the vertex shader rather
+    // than 4 vertices and 6 indices (off by default). Pays off for long runs
+    // of rects, each switch to other geometry starts a new draw call. Both
+    // paths build the same triangles.
+    void SetInstancedRects(bool enabled) { instancedRects = enabled; }
+
+    // max distance in pixels between a true circle/arc and its polygon, drives
+    // automatic segment counts. Any thread, taken over by the next Begin(),
+    // which rebuilds every cached window and forces the frame through.
+    void SetCircleMaxError(float maxError) { circleTable.SetMaxError(maxError); }
+    // the tolerance the current frame tessellates with
+    float GetCircleMaxError() const { return circleTable.GetMaxError(); }
+    // max distance in pixels between a Bezier curve and its flattened polyline
+    void SetCurveTolerance(float tolerance) { curveTolerance = tolerance > 0.01f ? tolerance : 0.01f; }
+
     // Access UI
     class Ui;
     Ui& GetUI() { return *ui; }
@@ -39,42 +170,224 @@ public:
     HWND GetHwnd() { return hwnd; }
     POINT GetWindowSize() { return { windowWidth, windowHeight }; };
 
+    // idle frames: when End() sees the same window contents (by their hashes,
+    // nothing is rehashed), the same geometry drawn outside the windows (that
+    // part is hashed) and the same input as in the previous frame it skips
+    // the upload, and IsFrameElided()
+    // tells the caller to skip Present too. InvalidateFrame() forces the next
+    // frame through, e.g. when a texture changed behind the renderer's back.
+    void SetFrameElision(bool enabled) { frameElision = enabled; }
+    void InvalidateFrame() { frameInvalidated = true; damageInvalidated = true; }
+    bool IsFrameElided() const { return frameElided; }
+    uint64_t GetElidedFrameCount() const { return elidedFrames; }
+
+    // The renderer clears the target itself. With partial redraw on (off by
+    // default, it needs a swap chain that keeps the back buffer, e.g.
+    // SEQUENTIAL with one buffer) only the rects the damage tracker reports are cleared and
+    // redrawn, falling back to the whole target past its threshold.
+    void SetRenderTarget(ID3D11RenderTargetView* target) { renderTarget = target; InvalidateFrame(); }
+    void SetClearColor(const Color& color) { clearColor = color; InvalidateFrame(); }
+    void SetPartialRedraw(bool enabled) { partialRedraw = enabled; damageInvalidated = true; }
+    const DamageTracker& GetDamage() const { return damage; }
+
+    // Depth-assisted drawing (off by default): opaque flat geometry is drawn
+    // first, front to back with depth writes, so what it hides is never
+    // shaded; text, images and blended geometry follow in painter's order.
+    // Same picture with less overdraw on layered windows, see DepthOrder.
+    void SetDepthPass(bool enabled) { depthPass = enabled; InvalidateFrame(); }
+    const DepthOrderStats& GetDepthOrderStats() const { return depthOrder.GetStats(); }
+
+    // Frame submission. By default End() draws with D3D11 on the calling
+    // thread and Window::present presents. With threaded rendering End()
+    // hands the frame to a render thread that draws and presents it (through
+    // the present callback) while the next frame is being built, and the
+    // calling thread never touches the device context. SetBackend swaps in
+    // another backend such as SoftwareBackend, nullptr goes back to D3D11.
+    // Wait for the render thread before touching the swap chain.
+    void SetThreadedRendering(bool enabled);
+    bool IsThreadedRendering() const { return renderThread != nullptr; }
+    void SetBackend(RenderBackend* backend);
+    void SetPresentCallback(std::function<void()> present) { presentCallback = std::move(present); }
+    void WaitForRenderThread();
+
+    // geometry of the current frame, kept until the next Begin (until End with
+    // threaded rendering, the list is handed to the render thread there)
+    const DrawList& GetDrawList() const { return drawList; }
+
+    // vertex/index streaming: ring (default) or discard every frame, plus counters
+    void SetUploadMode(UploadAllocator::Mode mode);
+    const UploadStats& GetVertexUploadStats() const { return vertexUpload->GetStats(); }
+    const UploadStats& GetIndexUploadStats() const { return indexUpload->GetStats(); }
+    const UploadStats& GetInstanceUploadStats() const { return instanceUpload->GetStats(); }
+    const UploadStats& GetShapeUploadStats() const { return shapeUpload->GetStats(); }
+
 private:
 
     // helpers
     void InitPipeline();
-    void FlushBatch();
-    void EnsureBufferSize(size_t count);
+    void InitInstancePipeline();
+    void InitShapePipeline();
+    void AddShape(float x, float y, float w, float h, float radius, float thickness, const Color& color);
+    // List the Add*/Path* calls of the calling thread write to, nullptr = the
+    // frame list. Per thread, so windows can be built in parallel.
+    void SetTargetList(DrawList* list) { threadTarget = { this, list }; }
+    DrawList& CurrentList() { return threadTarget.owner == this && threadTarget.list ? *threadTarget.list : drawList; }
+    void StrokePolyline(const Vec2* pts, int n, bool closed, uint32_t col, float halfThickness,
+        const Vec2* before = nullptr, const Vec2* after = nullptr);
+    void FlushBatch(const DrawList& list, int width, int height);
+    bool EnsureDepthBuffer(int width, int height);
+    uint64_t FrameFingerprint() const;
     bool LoadFontMap(const std::string& path);
-    void DrawChar(float x, float y, float w, float h, float u0, float v0, float u1, float v1, float r, float g, float b, float a);
+    bool ReadTexturePixels(ID3D11ShaderResourceView* view, std::vector<uint32_t>& pixels, int& width, int& height);
+    ID3D11ShaderResourceView* PageTexture(int page) const;     // texture for DrawList::SetTexture
 private:
 
     // Core D3D resources
     HWND hwnd = nullptr;
     ID3D11Device* device = nullptr;
     ID3D11DeviceContext* context = nullptr;
-    ID3D11Buffer* gpuVertexBuffer = nullptr;
-    size_t gpuBufferCapacity = 0;
+    ID3D11DeviceContext1* context1 = nullptr;     // nullptr before the 11.1 runtime
+    ID3D11RenderTargetView* renderTarget = nullptr;
+    std::unique_ptr<D3D11UploadBuffer> vertexStream;
+    std::unique_ptr<D3D11UploadBuffer> indexStream;
+    std::unique_ptr<UploadAllocator> vertexUpload;
+    std::unique_ptr<UploadAllocator> indexUpload;
+    std::unique_ptr<D3D11UploadBuffer> instanceStream;
+    std::unique_ptr<UploadAllocator> instanceUpload;
+    ID3D11InputLayout* instanceInputLayout = nullptr;
+    ID3D11VertexShader* instanceVertexShader = nullptr;
+    bool instancedRects = false;
+    SimdLevel simdLevel = DetectSimdLevel();
+    std::unique_ptr<D3D11UploadBuffer> shapeStream;
+    std::unique_ptr<UploadAllocator> shapeUpload;
+    ID3D11InputLayout* shapeInputLayout = nullptr;
+    ID3D11VertexShader* shapeVertexShader = nullptr;
+    ID3D11PixelShader* shapePixelShader = nullptr;
+    ID3D11Buffer* projectionBuffer = nullptr;
     ID3D11InputLayout* inputLayout = nullptr;
     ID3D11VertexShader* vertexShader = nullptr;
     ID3D11PixelShader* pixelShader = nullptr;
-    std::vector<Vertex> vertexBufferData;
-    size_t vertexCount = 0;
+    DrawList drawList;                      // frame list, uploaded by FlushBatch
+    struct TargetList {
+        const Renderer* owner;
+        DrawList* list;
+    };
+    static thread_local TargetList threadTarget;
+
+    // lists recorded by other threads, one per thread and kept across frames
+    struct ThreadList {
+        DrawList list;
+        int layer = 0;
+        uint64_t frame = 0;                 // frame it was last handed over in
+        ThreadList* next = nullptr;         // in submittedLists
+    };
+    struct ThreadListCache {
+        uint64_t owner;                     // instanceId of the renderer
+        ThreadList* node;
+    };
+    static thread_local ThreadListCache threadListCache;
+    static std::atomic<uint64_t> nextInstanceId;
+
+    ThreadList* AcquireThreadList();
+    void MergeThreadLists();
+
+    const uint64_t instanceId = ++nextInstanceId;
+    std::atomic<uint64_t> frameIndex{ 0 };
+    std::atomic<int> frameWidth{ 0 };                       // viewport as of Begin(), for recording threads
+    std::atomic<int> frameHeight{ 0 };
+    std::atomic<ThreadList*> submittedLists{ nullptr };    // lock-free stack, newest first
+    std::mutex threadListsMutex;                            // only for a thread's first recording
+    std::vector<std::unique_ptr<ThreadList>> threadLists;
+    std::vector<ThreadList*> mergeOrder;
+    DrawList mergeScratch;
     ID3D11Buffer* fontVertexBuffer = nullptr;
     ID3D11InputLayout* fontInputLayout = nullptr;
     ID3D11VertexShader* fontVertexShader = nullptr;
     ID3D11PixelShader* fontPixelShader = nullptr;
     ID3D11ShaderResourceView* fontTextureView = nullptr;
+    ID3D11ShaderResourceView* whiteTextureView = nullptr;
     ID3D11BlendState* alphaBlendState = nullptr;
     ID3D11SamplerState* fontSampler = nullptr;
+    ID3D11RasterizerState* rasterizerState = nullptr;
+
+    // images, icons and the font page
+    std::unique_ptr<D3D11AtlasDevice> atlasDevice;
+    std::unique_ptr<TextureAtlas> atlas;
+    ID3D11ShaderResourceView* glyphTexture = nullptr;  // texture the glyph uvs refer to
+
+    // dynamic textures, flushed where the frame is drawn
+    struct DynamicTextureEntry {
+        std::unique_ptr<D3D11StagingDevice> device;
+        std::unique_ptr<DynamicTexture> texture;
+    };
+    std::mutex dynamicTexturesMutex;
+    std::vector<DynamicTextureEntry> dynamicTextures;
+    bool HasDirtyDynamicTextures();
 
     // font map
     std::unordered_map<int, FontChar> fontMap;
+    const FontChar* glyphs[256] = {};   // byte -> glyph, points into fontMap
     int textureWidth = 254, textureHeight = 376;
 
     // window state
     int windowWidth = 1200, windowHeight = 720;
 
+    // idle frame elision
+    bool frameElision = true;
+    bool frameInvalidated = true;
+    bool frameElided = false;
+    uint64_t lastFingerprint = 0;
+    uint64_t directHash = 0;                // geometry outside the windows this frame
+    uint64_t elidedFrames = 0;
+
+    // partial redraw
+    Color clearColor = Color(0.f, 0.f, 0.f, 1.f);
+    bool partialRedraw = false;
+    // what FlushBatch draws with, copied from the three above when a frame is
+    // handed to the backend so the setters never race the render thread
+    struct TargetState {
+        ID3D11RenderTargetView* renderTarget = nullptr;
+        Color clearColor = Color(0.f, 0.f, 0.f, 1.f);
+        bool partialRedraw = false;
+    };
+    TargetState drawTarget;
+    std::atomic<bool> damageInvalidated{ true };    // set from the app thread, applied where the frame is drawn
+    DamageTracker damage;
+    std::atomic<bool> depthPass{ false };
+    DepthOrder depthOrder;                  // used where the frame is drawn
+    ID3D11DepthStencilView* depthView = nullptr;
+    int depthWidth = 0;
+    int depthHeight = 0;
+    ID3D11DepthStencilState* depthWriteState = nullptr;
+    ID3D11DepthStencilState* depthTestState = nullptr;
+
+    // the D3D11 path as a backend, presenting through the callback
+    class D3D11Backend : public RenderBackend {
+    public:
+        explicit D3D11Backend(Renderer* r) : renderer(r) {}
+        void RenderFrame(const DrawList& list, int width, int height) override {
+            renderer->FlushBatch(list, width, height);
+            renderer->vertexUpload->EndFrame();
+            renderer->indexUpload->EndFrame();
+            renderer->instanceUpload->EndFrame();
+            renderer->shapeUpload->EndFrame();
+        }
+        void Present() override { if (renderer->presentCallback) renderer->presentCallback(); }
+        void CaptureFrameState() override {
+            renderer->drawTarget = { renderer->renderTarget, renderer->clearColor, renderer->partialRedraw };
+        }
+    private:
+        Renderer* renderer;
+    };
+    D3D11Backend d3dBackend{ this };
+    RenderBackend* backend = &d3dBackend;
+    std::function<void()> presentCallback;
+    std::unique_ptr<RenderThread> renderThread;
+
+    // shared circle/arc tables
+    CircleTable circleTable;
+    float curveTolerance = 0.5f;
+
     std::unique_ptr<Ui> ui;
 };
 
@@ -105,6 +418,18 @@ public:
         virtual ~Component() = default;
         virtual void Update(const Context& ctx, float offsetX, float offsetY) = 0;
         virtual void Draw(Renderer* renderer, float offsetX, float offsetY) = 0;
+
+        // Hash of everything Draw() depends on apart from the window offset.
+        // Components that can't tell return Uncached and keep their window
+        // rebuilt every frame.
+        static constexpr uint64_t Uncached = 0;
+        virtual uint64_t Hash() const { return Uncached; }
+
+        // Screen area Draw() may touch. The default is unbounded, which ends
+        // up as the whole content area of the window.
+        virtual Rect GetBounds(const Renderer* renderer, float offsetX, float offsetY) const { return UnboundedClipRect; }
+
+        bool culled = false;        // hidden behind windows above, Draw() is skipped
     };
 
     // Window
@@ -117,6 +442,13 @@ public:
         float offset = 0.f;         // y value - where to place next component
 
         std::vector<std::unique_ptr<Component>> components;
+
+        // geometry from the last rebuild, reused while the hash stays the same
+        DrawList drawList;
+        uint64_t drawHash = Component::Uncached;
+        Vec2 drawPos = { 0.f, 0.f };    // x, y the cached geometry was built at
+
+        bool occluded = false;      // fully covered by opaque windows above
     };
 
     // Button
@@ -139,6 +471,17 @@ public:
             renderer->AddRectangle({ drawX, drawY }, { w, h }, Color(1, 1, 1, 1.f));
             renderer->AddText(drawX + 5, drawY + 5, label, Color(1, 1, 1, 1));
         }
+
+        uint64_t Hash() const override {
+            float geometry[4] = { x, y, w, h };
+            uint64_t hash = HashValue(geometry, HashString(label));
+            return HashValue(hovered, hash);
+        }
+
+        Rect GetBounds(const Renderer* renderer, float offsetX, float offsetY) const override {
+            // the border straddles the edge
+            return { x + offsetX - 1.f, y + offsetY - 1.f, x + offsetX + w + 1.f, y + offsetY + h + 1.f };
+        }
     };
 
     // Checkbox
@@ -163,9 +506,22 @@ public:
             float drawX = x + offsetX;
             float drawY = y + offsetY;
             renderer->AddRectangle({ drawX, drawY }, { size, size }, Color(1, 1, 1, 1));
-            if (checked) renderer->AddRectangleFilled({ drawX + 2, drawY + 2 }, { size - 5, size - 5 }, Color(1, 1, 1, 1));
+            if (checked) renderer->AddRectRounded({ drawX + 2, drawY + 2 }, { size - 5, size - 5 }, Color(1, 1, 1, 1), 2.f);
             renderer->AddText(drawX + size + 5, drawY, label, Color(1, 1, 1, 1));
         }
+
+        uint64_t Hash() const override {
+            float geometry[3] = { x, y, size };
+            uint64_t hash = HashValue(geometry, HashString(label));
+            return HashValue(checked, hash);
+        }
+
+        Rect GetBounds(const Renderer* renderer, float offsetX, float offsetY) const override {
+            Vec2 text = renderer->MeasureText(label);
+            float right = x + offsetX + size + 5.f + text.x;
+            float bottom = y + offsetY + (text.y > size ? text.y : size);
+            return { x + offsetX - 1.f, y + offsetY - 1.f, right + 1.f, bottom + 1.f };
+        }
     };
 
     // Slider
@@ -209,7 +565,7 @@ public:
 
             // Draw slider bar
             float barHeight = height / 3.f;
-            renderer->AddRectangleFilled({ drawX, drawY + (height - barHeight) / 2.f }, { width, barHeight }, UserInterfaceColors::SliderBar);
+            renderer->AddRectRounded({ drawX, drawY + (height - barHeight) / 2.f }, { width, barHeight }, UserInterfaceColors::SliderBar, barHeight * 0.5f);
 
             // knob
             float normalizedValue = *value ? *value : 0.f;
@@ -217,11 +573,24 @@ public:
             float knobHeight = height;
             float knobX = drawX + normalizedValue * width - knobWidth / 2.f;
             float knobY = drawY;
-            renderer->AddRectangleFilled({ knobX, knobY }, { knobWidth, knobHeight }, hovered || dragging ? UserInterfaceColors::SliderHover : UserInterfaceColors::SliderKnob);
+            renderer->AddRectRounded({ knobX, knobY }, { knobWidth, knobHeight }, hovered || dragging ? UserInterfaceColors::SliderHover : UserInterfaceColors::SliderKnob, 3.f);
 
             // Draw label
             // renderer->AddText(drawX, drawY - 15.f, label, UserInterfaceColors::TextColor);
         }
+
+        uint64_t Hash() const override {
+            float geometry[4] = { x, y, width, height };
+            uint64_t hash = HashValue(geometry);
+            hash = HashValue(value ? *value : 0.f, hash);
+            return HashValue(hovered || dragging, hash);
+        }
+
+        Rect GetBounds(const Renderer* renderer, float offsetX, float offsetY) const override {
+            // the knob hangs half its width over both ends
+            float knob = UserInterfaceStyles::SliderKnobWidth / 2.f;
+            return { x + offsetX - knob, y + offsetY, x + offsetX + width + knob, y + offsetY + height };
+        }
     };
 
     // Text
@@ -240,6 +609,15 @@ public:
 
             renderer->AddText(drawX, drawY, label, UserInterfaceColors::TextColor);
         }
+
+        uint64_t Hash() const override {
+            return HashValue(Vec2{ x, y }, HashString(label));
+        }
+
+        Rect GetBounds(const Renderer* renderer, float offsetX, float offsetY) const override {
+            Vec2 text = renderer->MeasureText(label);
+            return { x + offsetX - 1.f, y + offsetY - 1.f, x + offsetX + text.x + 1.f, y + offsetY + text.y + 1.f };
+        }
     };
 
     // Text Input
@@ -307,6 +685,21 @@ public:
                 // renderer->AddRectangleFilled({ caretX, drawY + 4.f }, { 1.f, height - 8.f }, UserInterfaceColors::TextColor);
             }
         }
+
+        uint64_t Hash() const override {
+            uint64_t hash = HashValue(Vec2{ x, y }, value ? HashString(*value) : HashSeed);
+            return HashValue(focused && caretVisible ? 2 : (focused ? 1 : 0), hash);
+        }
+
+        Rect GetBounds(const Renderer* renderer, float offsetX, float offsetY) const override {
+            // the text may run past the box
+            Vec2 text = value ? renderer->MeasureText(*value) : Vec2{ 0.f, 0.f };
+            float right = x + offsetX + UserInterfaceStyles::BasePadding + text.x;
+            float bottom = y + offsetY + UserInterfaceStyles::TextInputTextOffset + text.y;
+            float boxRight = x + offsetX + UserInterfaceStyles::TextInputWidth;
+            float boxBottom = y + offsetY + UserInterfaceStyles::TextInputHeight;
+            return { x + offsetX, y + offsetY, (right > boxRight ? right : boxRight) + 1.f, (bottom > boxBottom ? bottom : boxBottom) + 1.f };
+        }
     };
 
 
@@ -325,6 +718,23 @@ public:
     Window* GetCurrentWindow() { return currentWindow; } 
     Renderer* GetRenderer() { return renderer; };
 
+    // windows rebuilt / spliced from their cached geometry in the last End()
+    int GetRebuiltWindowCount() const { return rebuiltWindows; }
+    int GetCachedWindowCount() const { return cachedWindows; }
+    // windows and components skipped in the last End() because opaque windows covered them
+    int GetOccludedWindowCount() const { return occludedWindows; }
+    int GetCulledComponentCount() const { return culledComponents; }
+    // Content hashes and positions of the windows spliced in the last End(),
+    // in z-order. A window without a hash changes it every frame.
+    uint64_t GetContentHash() const { return contentHash; }
+
+    // Drops the cached geometry of every window, End() rebuilds them all
+    void InvalidateCaches();
+
+    // Build changed windows on worker threads (default on). Component::Draw
+    // then runs off the calling thread, custom components must allow that.
+    void SetParallelBuild(bool enabled) { parallelBuild = enabled; }
+
 private:
     Renderer* renderer;
     Context context;
@@ -333,4 +743,25 @@ private:
     Window* m_draggedWindow = nullptr;              // window being dragged
     Component* m_focusedComponent = nullptr;        // component focused
     Vec2 dragOffset;                                // drag distance
+    int rebuiltWindows = 0;
+    int cachedWindows = 0;
+    int occludedWindows = 0;
+    int culledComponents = 0;
+    uint64_t contentHash = HashSeed;
+    uint64_t uncachedBuilds = 0;
+
+    // parallel window builds, pool created on first use
+    bool parallelBuild = true;
+    std::vector<Window*> rebuildQueue;
+    std::unique_ptr<WorkerPool> workers;
+
+    // occlusion: rects of opaque windows in front of the one being tested
+    std::vector<Rect> coverRects;
+    std::vector<Rect> coverPieces;
+    std::vector<Rect> coverNext;
+
+    void ComputeOcclusion();
+    bool IsCovered(const Rect& r);
+    uint64_t WindowHash(const Window& win) const;
+    void BuildWindow(Window& win);
 };
\ No newline at end of file
@@ -1,11 +1,31 @@
 #pragma once
 #include <d3d11.h>
 #include <DirectXMath.h>
+#include <cstdint>
+
+// float [0,1] -> unorm8 / unorm16, clamped and rounded to nearest. NaN
+// becomes 0, converting it to an integer would be undefined.
+inline uint32_t PackUnorm8(float v) {
+    v = v > 0.f ? (v < 1.f ? v : 1.f) : 0.f;
+    return (uint32_t)(v * 255.f + 0.5f);
+}
+
+inline uint16_t PackUnorm16(float v) {
+    v = v > 0.f ? (v < 1.f ? v : 1.f) : 0.f;
+    return (uint16_t)(v * 65535.f + 0.5f);
+}
+
+// RGBA8 laid out for DXGI_FORMAT_R8G8B8A8_UNORM (r in the low byte)
+inline uint32_t PackRGBA8(float r, float g, float b, float a) {
+    return PackUnorm8(r) | (PackUnorm8(g) << 8) | (PackUnorm8(b) << 16) | (PackUnorm8(a) << 24);
+}
 
 struct Color {
     Color() = default;
     float r, g, b, a;
     Color(float r, float g, float b, float a = 1.0f) : r(r), g(g), b(b), a(a) {}
+
+    uint32_t ToRGBA8() const { return PackRGBA8(r, g, b, a); }
 };
 
 struct Vec2 {
@@ -56,12 +76,45 @@ struct Vec3 {
     }
 };
 
+// Axis-aligned rectangle in pixels, right and bottom are exclusive
+struct Rect {
+    float left, top, right, bottom;
+
+    bool IsEmpty() const { return right <= left || bottom <= top; }
+
+    bool Overlaps(const Rect& other) const {
+        return left < other.right && other.left < right && top < other.bottom && other.top < bottom;
+    }
+
+    bool Contains(const Rect& other) const {
+        return other.left >= left && other.top >= top && other.right <= right && other.bottom <= bottom;
+    }
+
+    Rect Intersect(const Rect& other) const {
+        return {
+            left > other.left ? left : other.left,
+            top > other.top ? top : other.top,
+            right < other.right ? right : other.right,
+            bottom < other.bottom ? bottom : other.bottom,
+        };
+    }
+
+    bool operator==(const Rect& other) const {
+        return left == other.left && top == other.top && right == other.right && bottom == other.bottom;
+    }
+
+    bool operator!=(const Rect& other) const {
+        return !(*this == other);
+    }
+};
+
+// The texture is chosen per draw command, not per vertex.
 struct Vertex {
-    float x, y, z;        // 12 bytes
-    float r, g, b, a;     // 16 bytes  (offset 12)
-    float u, v;           // 8 bytes   (offset 28)
-    float texIndex;       // 4 bytes   (offset 36)
+    float x, y;           // 8 bytes
+    uint16_t u, v;        // 4 bytes   (offset 8)  unorm16 texture coordinates
+    uint32_t col;         // 4 bytes   (offset 12) packed RGBA8
 };
+static_assert(sizeof(Vertex) == 16, "Vertex layout must match the input layout");
 
 struct FontChar {
     int id;
@@ -0,0 +1,52 @@
+#pragma once
+#include <d3d11.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// One analytic shape of the instance stream: a rounded rect, which covers
+// circles (radius = half the side) and, with a thickness, outlines and rings.
+// It is drawn as a single quad, the pixel shader works out how much of each
+// pixel the shape covers, so edges come out anti-aliased at a fixed cost.
+struct ShapeInstance {
+    float x, y, w, h;   // bounds of the shape, w and h positive
+    uint32_t col;       // packed RGBA8
+    float radius;       // corner radius, at most half the smaller side
+    float thickness;    // 0 = filled, otherwise only this band inside the edge
+};
+static_assert(sizeof(ShapeInstance) == 28, "ShapeInstance layout must match the shape input layout");
+
+// Quads reach this far past the bounds so the edge ramp is not cut off
+constexpr float ShapeFringe = 1.f;
+constexpr UINT ShapeVertices = 6;
+
+// Signed distance from a point to the edge of the shape, negative inside
+inline float ShapeDistance(const ShapeInstance& s, float px, float py)
+{
+    float hx = s.w * 0.5f, hy = s.h * 0.5f;
+    float qx = std::fabs(px - (s.x + hx)) - hx + s.radius;
+    float qy = std::fabs(py - (s.y + hy)) - hy + s.radius;
+    float ox = std::max(qx, 0.f), oy = std::max(qy, 0.f);
+    float d = std::sqrt(ox * ox + oy * oy) + std::min(std::max(qx, qy), 0.f) - s.radius;
+
+    // a band: inside the outer edge and outside the edge thickness further in
+    if (s.thickness > 0.f) d = std::max(d, -(d + s.thickness));
+    return d;
+}
+
+// Fraction of the pixel centred on px, py the shape covers: a one pixel wide
+// ramp across the edge. This is the reference for the shape pixel shader,
+// which evaluates the same expression at SV_Position.
+inline float ShapeCoverage(const ShapeInstance& s, float px, float py)
+{
+    return std::clamp(0.5f - ShapeDistance(s, px, py), 0.f, 1.f);
+}
+
+// Corner vertexId of the quad, the two triangles of DrawList::PrimRect
+inline void ShapeQuadVertex(const ShapeInstance& s, int vertexId, float& outX, float& outY)
+{
+    static const int quadIndex[6] = { 0, 1, 2, 2, 3, 0 };
+    int corner = quadIndex[vertexId];
+    outX = (corner == 1 || corner == 2) ? s.x + s.w + ShapeFringe : s.x - ShapeFringe;
+    outY = corner >= 2 ? s.y + s.h + ShapeFringe : s.y - ShapeFringe;
+}
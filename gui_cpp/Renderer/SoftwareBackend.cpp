@@ -0,0 +1,168 @@
+#include "RenderBackend.h"
+#include <algorithm>
+#include <cmath>
+
+// straight alpha, src over dst
+static uint32_t Blend(uint32_t src, uint32_t dst)
+{
+    uint32_t a = src >> 24;
+    if (a == 255) return src;
+    if (a == 0) return dst;
+
+    uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t s = (shift == 24) ? 255 : (src >> shift) & 0xff;
+        uint32_t d = (dst >> shift) & 0xff;
+        uint32_t c = (s * a + d * (255 - a) + 127) / 255;
+        out |= c << shift;
+    }
+    return out;
+}
+
+void SoftwareBackend::RenderFrame(const DrawList& list, int width, int height)
+{
+    targetWidth = std::max(width, 0);
+    targetHeight = std::max(height, 0);
+    pixels.assign((size_t)targetWidth * targetHeight, clearColor);
+    frameCount++;
+    pixelsShaded = 0;
+    pixelsRejected = 0;
+
+    if (!depthPass) {
+        depthMode = DepthMode::Off;
+        for (const DrawCommand& cmd : list.cmdBuffer) DrawCommandPixels(list, cmd);
+        return;
+    }
+
+    // the order and depth test the D3D11 path uses
+    depth.assign(pixels.size(), 1.f);
+    depthOrder.Build(list);
+    depthMode = DepthMode::Write;
+    for (const DepthRun& run : depthOrder.GetOpaque()) {
+        commandDepth = run.depth;
+        DrawCommandPixels(list, DepthOrder::Slice(list, run));
+    }
+    depthMode = DepthMode::Test;
+    for (const DepthRun& run : depthOrder.GetTranslucent()) {
+        commandDepth = run.depth;
+        DrawCommandPixels(list, DepthOrder::Slice(list, run));
+    }
+}
+
+void SoftwareBackend::DrawCommandPixels(const DrawList& list, const DrawCommand& cmd)
+{
+    if (cmd.IsEmpty()) return;
+
+    // same rounding as the scissor rects of the D3D11 path
+    int clipLeft = (int)std::floor(std::max(cmd.clipRect.left, 0.f));
+    int clipTop = (int)std::floor(std::max(cmd.clipRect.top, 0.f));
+    int clipRight = (int)std::ceil(std::min(cmd.clipRect.right, (float)targetWidth));
+    int clipBottom = (int)std::ceil(std::min(cmd.clipRect.bottom, (float)targetHeight));
+    if (clipRight <= clipLeft || clipBottom <= clipTop) return;
+
+    if (cmd.instCount > 0 && cmd.shapeInstances) {
+        for (UINT i = 0; i < cmd.instCount; i++)
+            FillShape(list.shapeBuffer[cmd.instOffset + i], clipLeft, clipTop, clipRight, clipBottom);
+        return;
+    }
+
+    if (cmd.instCount > 0) {
+        // the expansion the instanced vertex shader does
+        for (UINT i = 0; i < cmd.instCount; i++) {
+            const RectInstance& rect = list.instBuffer[cmd.instOffset + i];
+            for (UINT v = 0; v + 2 < cmd.instVertexCount; v += 3) {
+                Vertex tri[3];
+                for (UINT k = 0; k < 3; k++) {
+                    Vec2 p = RectInstanceVertex(rect, (int)(v + k));
+                    tri[k] = { p.x, p.y, 0, 0, rect.col };
+                }
+                FillTriangle(tri[0], tri[1], tri[2], clipLeft, clipTop, clipRight, clipBottom);
+            }
+        }
+        return;
+    }
+
+    const Vertex* vtx = list.vtxBuffer.data() + cmd.vtxOffset;
+    const DrawIndex* idx = list.idxBuffer.data() + cmd.idxOffset;
+    for (UINT i = 0; i + 2 < cmd.elemCount; i += 3)
+        FillTriangle(vtx[idx[i]], vtx[idx[i + 1]], vtx[idx[i + 2]], clipLeft, clipTop, clipRight, clipBottom);
+}
+
+// LESS_EQUAL against the depth of the current command, like the GPU
+bool SoftwareBackend::DepthTest(size_t index)
+{
+    if (depthMode != DepthMode::Off) {
+        if (commandDepth > depth[index]) {
+            pixelsRejected++;
+            return false;
+        }
+        if (depthMode == DepthMode::Write) depth[index] = commandDepth;
+    }
+    pixelsShaded++;
+    return true;
+}
+
+// Pixel centres inside the triangle, either winding. Shared edges use a
+// top-left rule so adjacent triangles don't blend a pixel twice.
+void SoftwareBackend::FillTriangle(const Vertex& a, const Vertex& b, const Vertex& c, int clipLeft, int clipTop, int clipRight, int clipBottom)
+{
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (area == 0.f) return;
+
+    const Vertex* v0 = &a;
+    const Vertex* v1 = area > 0.f ? &b : &c;
+    const Vertex* v2 = area > 0.f ? &c : &b;
+
+    int minX = std::max(clipLeft, (int)std::floor(std::min({ a.x, b.x, c.x })));
+    int minY = std::max(clipTop, (int)std::floor(std::min({ a.y, b.y, c.y })));
+    int maxX = std::min(clipRight - 1, (int)std::ceil(std::max({ a.x, b.x, c.x })));
+    int maxY = std::min(clipBottom - 1, (int)std::ceil(std::max({ a.y, b.y, c.y })));
+    if (minX > maxX || minY > maxY) return;
+
+    auto edge = [](const Vertex* p, const Vertex* q, float x, float y) {
+        return (q->x - p->x) * (y - p->y) - (q->y - p->y) * (x - p->x);
+    };
+    // a shared edge runs in opposite directions in its two triangles, so
+    // "points up, or horizontal and points left" gives its pixels to one
+    auto owns = [](const Vertex* p, const Vertex* q) {
+        return q->y < p->y || (q->y == p->y && q->x < p->x);
+    };
+    bool own0 = owns(v1, v2), own1 = owns(v2, v0), own2 = owns(v0, v1);
+
+    uint32_t col = a.col;
+    for (int y = minY; y <= maxY; y++) {
+        float py = y + 0.5f;
+        uint32_t* row = pixels.data() + (size_t)y * targetWidth;
+        for (int x = minX; x <= maxX; x++) {
+            float px = x + 0.5f;
+            float w0 = edge(v1, v2, px, py);
+            float w1 = edge(v2, v0, px, py);
+            float w2 = edge(v0, v1, px, py);
+            if (w0 < 0.f || w1 < 0.f || w2 < 0.f) continue;
+            if ((w0 == 0.f && !own0) || (w1 == 0.f && !own1) || (w2 == 0.f && !own2)) continue;
+            if (!DepthTest((size_t)y * targetWidth + x)) continue;
+            row[x] = Blend(col, row[x]);
+        }
+    }
+}
+
+// What the shape pixel shader does for every pixel of the quad
+void SoftwareBackend::FillShape(const ShapeInstance& shape, int clipLeft, int clipTop, int clipRight, int clipBottom)
+{
+    int minX = std::max(clipLeft, (int)std::floor(shape.x - ShapeFringe));
+    int minY = std::max(clipTop, (int)std::floor(shape.y - ShapeFringe));
+    int maxX = std::min(clipRight - 1, (int)std::ceil(shape.x + shape.w + ShapeFringe));
+    int maxY = std::min(clipBottom - 1, (int)std::ceil(shape.y + shape.h + ShapeFringe));
+
+    uint32_t alpha = shape.col >> 24;
+    for (int y = minY; y <= maxY; y++) {
+        uint32_t* row = pixels.data() + (size_t)y * targetWidth;
+        for (int x = minX; x <= maxX; x++) {
+            float coverage = ShapeCoverage(shape, x + 0.5f, y + 0.5f);
+            if (coverage <= 0.f) continue;
+            if (!DepthTest((size_t)y * targetWidth + x)) continue;
+            uint32_t a = (uint32_t)(alpha * coverage + 0.5f);
+            row[x] = Blend((shape.col & 0x00ffffff) | (a << 24), row[x]);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#include "Tessellation.h"
+
+static float Cross(const Vec2& a, const Vec2& b, const Vec2& c)
+{
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+bool Triangulator::IsConvex(int i) const
+{
+    // collinear corners count as convex, clipping them is harmless
+    return Cross(pts[prev[i]], pts[i], pts[next[i]]) * orientation >= 0.f;
+}
+
+bool Triangulator::IsEar(int i) const
+{
+    if (reflex[i]) return false;
+
+    int p = prev[i], n = next[i];
+    const Vec2& a = pts[p];
+    const Vec2& b = pts[i];
+    const Vec2& c = pts[n];
+
+    // only reflex corners can poke into a convex corner's triangle
+    for (int j = next[n]; j != p; j = next[j]) {
+        if (!reflex[j]) continue;
+        const Vec2& q = pts[j];
+        if (Cross(a, b, q) * orientation >= 0.f &&
+            Cross(b, c, q) * orientation >= 0.f &&
+            Cross(c, a, q) * orientation >= 0.f)
+            return false;
+    }
+    return true;
+}
+
+int Triangulator::Triangulate(const Vec2* points, int count, uint16_t baseIndex, uint16_t* out)
+{
+    return Clip(points, count, baseIndex, out);
+}
+
+int Triangulator::Triangulate(const Vec2* points, int count, uint32_t* out)
+{
+    return Clip(points, count, 0, out);
+}
+
+template <typename Index>
+int Triangulator::Clip(const Vec2* points, int count, uint32_t baseIndex, Index* out)
+{
+    if (count < 3) return 0;
+
+    pts = points;
+    prev.resize(count);
+    next.resize(count);
+    reflex.resize(count);
+
+    float area = 0.f;
+    for (int i = 0, j = count - 1; i < count; j = i++)
+        area += points[j].x * points[i].y - points[i].x * points[j].y;
+    orientation = area < 0.f ? -1.f : 1.f;
+
+    for (int i = 0; i < count; i++) {
+        prev[i] = i == 0 ? count - 1 : i - 1;
+        next[i] = i == count - 1 ? 0 : i + 1;
+    }
+    for (int i = 0; i < count; i++)
+        reflex[i] = !IsConvex(i);
+
+    Index* write = out;
+    auto emit = [&](int a, int b, int c) {
+        write[0] = (Index)(baseIndex + a);
+        write[1] = (Index)(baseIndex + b);
+        write[2] = (Index)(baseIndex + c);
+        write += 3;
+    };
+
+    int remaining = count;
+    int i = 0;
+    int misses = 0;
+    while (remaining > 3) {
+        // a full lap without an ear means the input is not simple, clip anyway
+        // so the call always terminates with the expected triangle count
+        if (IsEar(i) || misses > remaining) {
+            int p = prev[i], n = next[i];
+            emit(p, i, n);
+            next[p] = n;
+            prev[n] = p;
+            remaining--;
+            reflex[p] = !IsConvex(p);
+            reflex[n] = !IsConvex(n);
+            misses = 0;
+            i = p;
+        }
+        else {
+            misses++;
+            i = next[i];
+        }
+    }
+    emit(prev[i], i, next[i]);
+
+    return (int)(write - out);
+}
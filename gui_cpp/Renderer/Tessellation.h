@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+#include "RendererPrimitives.h"
+
+// Ear-clipping triangulation of simple polygons, either winding. The link and
+// reflex arrays are kept between calls, so once they have grown to the largest
+// polygon seen no further allocation happens.
+class Triangulator {
+public:
+    // Writes (count - 2) triangles as indices into `points`, offset by
+    // baseIndex, to out (which must have room for (count - 2) * 3 entries).
+    // Self-intersecting or degenerate input still produces that many
+    // triangles, they just won't cover the shape exactly. count <= 65536.
+    // Returns the number of indices written, 0 for fewer than 3 points.
+    int Triangulate(const Vec2* points, int count, uint16_t baseIndex, uint16_t* out);
+    // Same triangles as plain 32-bit indices into `points`, any count
+    int Triangulate(const Vec2* points, int count, uint32_t* out);
+
+private:
+    template <typename Index>
+    int Clip(const Vec2* points, int count, uint32_t baseIndex, Index* out);
+    bool IsConvex(int i) const;
+    bool IsEar(int i) const;
+
+    const Vec2* pts = nullptr;
+    float orientation = 1.f;        // sign of the polygon area
+    std::vector<int> prev;
+    std::vector<int> next;
+    std::vector<uint8_t> reflex;
+};
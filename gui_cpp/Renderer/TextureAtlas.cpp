@@ -0,0 +1,265 @@
+#include "TextureAtlas.h"
+#include <algorithm>
+#include <climits>
+#include <iostream>
+
+void SkylinePacker::Reset(int w, int h)
+{
+    width = w;
+    height = h;
+    usedArea = 0;
+    skyline.clear();
+    skyline.push_back({ 0, 0, w });
+}
+
+int SkylinePacker::Fit(size_t index, int w, int h) const
+{
+    int x = skyline[index].x;
+    if (x + w > width) return -1;
+
+    // the rect rests on the highest segment below it
+    int y = 0;
+    int remaining = w;
+    for (size_t i = index; remaining > 0 && i < skyline.size(); i++) {
+        y = std::max(y, skyline[i].y);
+        if (y + h > height) return -1;
+        remaining -= skyline[i].w;
+    }
+    return y;
+}
+
+bool SkylinePacker::Pack(int w, int h, int& outX, int& outY)
+{
+    if (w <= 0 || h <= 0 || w > width || h > height) return false;
+
+    size_t best = SIZE_MAX;
+    int bestBottom = INT_MAX;
+    int bestWidth = INT_MAX;
+    int bestY = 0;
+    for (size_t i = 0; i < skyline.size(); i++) {
+        int y = Fit(i, w, h);
+        if (y < 0) continue;
+        if (y + h < bestBottom || (y + h == bestBottom && skyline[i].w < bestWidth)) {
+            best = i;
+            bestBottom = y + h;
+            bestWidth = skyline[i].w;
+            bestY = y;
+        }
+    }
+    if (best == SIZE_MAX) return false;
+
+    outX = skyline[best].x;
+    outY = bestY;
+    skyline.insert(skyline.begin() + best, { outX, bestY + h, w });
+
+    // cut the segments the new one now covers
+    for (size_t i = best + 1; i < skyline.size();) {
+        const Segment& prev = skyline[i - 1];
+        int overlap = prev.x + prev.w - skyline[i].x;
+        if (overlap <= 0) break;
+
+        skyline[i].x += overlap;
+        skyline[i].w -= overlap;
+        if (skyline[i].w > 0) break;
+        skyline.erase(skyline.begin() + i);
+    }
+
+    // neighbours at the same height become one segment
+    for (size_t i = 0; i + 1 < skyline.size();) {
+        if (skyline[i].y == skyline[i + 1].y) {
+            skyline[i].w += skyline[i + 1].w;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else {
+            i++;
+        }
+    }
+
+    usedArea += w * h;
+    return true;
+}
+
+TextureAtlas::TextureAtlas(IAtlasDevice* dev, int size)
+    : device(dev), pageSize(size)
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    for (auto& page : pages) {
+        if (page->texture) device->ReleasePage(page->texture);
+    }
+}
+
+TextureAtlas::Page* TextureAtlas::AddPage(int width, int height)
+{
+    auto page = std::make_unique<Page>();
+    page->width = width;
+    page->height = height;
+    page->pixels.assign((size_t)width * height, 0);
+    page->packer.Reset(width, height);
+
+    // the white block lands at the origin of the empty page, its padding is
+    // white as well so sampling uv (0, 0) never bleeds into a neighbour
+    int whiteX = 0, whiteY = 0;
+    int block = WhiteSize + Padding;
+    page->packer.Pack(block, block, whiteX, whiteY);
+    for (int y = 0; y < block; y++)
+        std::fill_n(&page->pixels[(size_t)y * width], block, 0xffffffffu);
+
+    page->texture = device->CreatePage(width, height);
+    if (!page->texture) std::cerr << "Failed to create atlas page\n";
+
+    MarkDirty(*page, 0, 0, width, height);
+    pages.push_back(std::move(page));
+    return pages.back().get();
+}
+
+void TextureAtlas::MarkDirty(Page& page, int x, int y, int w, int h)
+{
+    if (page.dirtyRight <= page.dirtyLeft) {
+        page.dirtyLeft = x;
+        page.dirtyTop = y;
+        page.dirtyRight = x + w;
+        page.dirtyBottom = y + h;
+        return;
+    }
+    page.dirtyLeft = std::min(page.dirtyLeft, x);
+    page.dirtyTop = std::min(page.dirtyTop, y);
+    page.dirtyRight = std::max(page.dirtyRight, x + w);
+    page.dirtyBottom = std::max(page.dirtyBottom, y + h);
+}
+
+ImageId TextureAtlas::Add(const uint32_t* src, int width, int height)
+{
+    if (!src || width <= 0 || height <= 0) return InvalidImage;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    int paddedW = width + 2 * Padding;
+    int paddedH = height + 2 * Padding;
+
+    Page* page = nullptr;
+    int pageIndex = 0;
+    int x = 0, y = 0;
+    for (; pageIndex < (int)pages.size(); pageIndex++) {
+        if (pages[pageIndex]->packer.Pack(paddedW, paddedH, x, y)) {
+            page = pages[pageIndex].get();
+            break;
+        }
+    }
+    if (!page) {
+        // room for the white block above an image as large as the page
+        int w = std::max(pageSize, paddedW);
+        int h = std::max(pageSize, paddedH + WhiteSize + Padding);
+        page = AddPage(w, h);
+        if (!page->packer.Pack(paddedW, paddedH, x, y)) return InvalidImage;
+    }
+
+    // copy with the edge pixels repeated into the padding, so filtering at
+    // the border of the image samples the image itself
+    int ox = x + Padding, oy = y + Padding;
+    for (int row = -Padding; row < height + Padding; row++) {
+        const uint32_t* srcRow = src + (size_t)std::clamp(row, 0, height - 1) * width;
+        uint32_t* dst = &page->pixels[(size_t)(oy + row) * page->width + ox];
+        for (int col = -Padding; col < width + Padding; col++)
+            dst[col] = srcRow[std::clamp(col, 0, width - 1)];
+    }
+    MarkDirty(*page, x, y, paddedW, paddedH);
+
+    AtlasRegion region;
+    region.page = pageIndex;
+    region.x = ox;
+    region.y = oy;
+    region.width = width;
+    region.height = height;
+    region.uvMin = { (float)ox / page->width, (float)oy / page->height };
+    region.uvMax = { (float)(ox + width) / page->width, (float)(oy + height) / page->height };
+    regions.push_back(region);
+    return (ImageId)regions.size() - 1;
+}
+
+AtlasRegion TextureAtlas::GetRegion(ImageId image) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (image < 0 || image >= (ImageId)regions.size()) return AtlasRegion();
+    return regions[image];
+}
+
+ID3D11ShaderResourceView* TextureAtlas::GetPageTexture(int page) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (page < 0 || page >= (int)pages.size()) return nullptr;
+    return pages[page]->texture;
+}
+
+int TextureAtlas::GetPageCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return (int)pages.size();
+}
+
+int TextureAtlas::GetImageCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return (int)regions.size();
+}
+
+void TextureAtlas::Flush()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& page : pages) {
+        if (page->dirtyRight <= page->dirtyLeft) continue;
+
+        if (page->texture) {
+            const uint32_t* first = &page->pixels[(size_t)page->dirtyTop * page->width + page->dirtyLeft];
+            device->UpdatePage(page->texture, page->dirtyLeft, page->dirtyTop,
+                page->dirtyRight - page->dirtyLeft, page->dirtyBottom - page->dirtyTop, first, page->width);
+        }
+        page->dirtyLeft = page->dirtyTop = page->dirtyRight = page->dirtyBottom = 0;
+    }
+}
+
+D3D11AtlasDevice::D3D11AtlasDevice(ID3D11Device* dev, ID3D11DeviceContext* ctx)
+    : device(dev), context(ctx)
+{
+}
+
+ID3D11ShaderResourceView* D3D11AtlasDevice::CreatePage(int width, int height)
+{
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = (UINT)width;
+    desc.Height = (UINT)height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    ID3D11Texture2D* texture = nullptr;
+    HRESULT hr = device->CreateTexture2D(&desc, nullptr, &texture);
+    if (FAILED(hr)) return nullptr;
+
+    // the view keeps the texture alive
+    ID3D11ShaderResourceView* view = nullptr;
+    hr = device->CreateShaderResourceView(texture, nullptr, &view);
+    texture->Release();
+    if (FAILED(hr)) return nullptr;
+    return view;
+}
+
+void D3D11AtlasDevice::UpdatePage(ID3D11ShaderResourceView* page, int x, int y, int w, int h, const uint32_t* pixels, int pitch)
+{
+    ID3D11Resource* resource = nullptr;
+    page->GetResource(&resource);
+
+    D3D11_BOX box = { (UINT)x, (UINT)y, 0, (UINT)(x + w), (UINT)(y + h), 1 };
+    context->UpdateSubresource(resource, 0, &box, pixels, (UINT)pitch * sizeof(uint32_t), 0);
+    resource->Release();
+}
+
+void D3D11AtlasDevice::ReleasePage(ID3D11ShaderResourceView* page)
+{
+    page->Release();
+}
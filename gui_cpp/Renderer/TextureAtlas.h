@@ -0,0 +1,130 @@
+#pragma once
+#include <d3d11.h>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+#include "RendererPrimitives.h"
+
+typedef int ImageId;
+constexpr ImageId InvalidImage = -1;
+
+// Skyline bottom-left packer. The top edge of everything packed so far is
+// kept as a list of horizontal segments, and each rect goes where its bottom
+// ends up highest on screen (lowest y), ties going to the narrowest segment.
+class SkylinePacker {
+public:
+    void Reset(int width, int height);
+
+    // Position for a w x h rect, false when it does not fit anymore
+    bool Pack(int w, int h, int& x, int& y);
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    int GetUsedArea() const { return usedArea; }
+
+private:
+    struct Segment {
+        int x, y, w;    // covers [x, x + w) at height y
+    };
+
+    // y a w x h rect gets when its left edge sits on segment index, -1 if it does not fit
+    int Fit(size_t index, int w, int h) const;
+
+    std::vector<Segment> skyline;
+    int width = 0;
+    int height = 0;
+    int usedArea = 0;
+};
+
+// Where an image lives in the atlas
+struct AtlasRegion {
+    int page = -1;
+    int x = 0, y = 0;               // top-left in pixels, padding excluded
+    int width = 0, height = 0;
+    Vec2 uvMin = { 0.f, 0.f };
+    Vec2 uvMax = { 0.f, 0.f };
+};
+
+// Device side of the atlas pages, behind an interface like IUploadDevice so
+// packing and UVs can be checked with a fake device.
+class IAtlasDevice {
+public:
+    virtual ~IAtlasDevice() = default;
+
+    // Creates an RGBA8 page, nullptr on failure. Called from whichever
+    // thread adds the image, so it must not touch the device context.
+    virtual ID3D11ShaderResourceView* CreatePage(int width, int height) = 0;
+    // Copies a w x h block of pixels (pitch in pixels) to x, y of the page
+    virtual void UpdatePage(ID3D11ShaderResourceView* page, int x, int y, int w, int h, const uint32_t* pixels, int pitch) = 0;
+    virtual void ReleasePage(ID3D11ShaderResourceView* page) = 0;
+};
+
+// Images, icons and font pages packed into a few large RGBA8 textures, so
+// anything that shares a page can go into one draw call. Every page starts
+// with a white block at its origin: geometry with uv (0, 0) comes out in
+// flat colour on any page, so flat primitives batch with images too.
+//
+// The CPU copy of each page is kept. Add() may be called from any thread and
+// only marks the touched area dirty, Flush() uploads it and must run on the
+// thread that owns the device context, before drawing.
+class TextureAtlas {
+public:
+    static constexpr int DefaultPageSize = 1024;
+    static constexpr int Padding = 1;           // border around each image, filled with its edge pixels
+    static constexpr int WhiteSize = 2;         // white block at the origin of every page
+
+    explicit TextureAtlas(IAtlasDevice* device, int pageSize = DefaultPageSize);
+    ~TextureAtlas();
+
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    // Copies a width x height image in, pixels RGBA8 with r in the low byte
+    // like Color::ToRGBA8. Images larger than a page get a page of their own.
+    ImageId Add(const uint32_t* pixels, int width, int height);
+
+    // Region of an image, page -1 for an unknown id
+    AtlasRegion GetRegion(ImageId image) const;
+    ID3D11ShaderResourceView* GetPageTexture(int page) const;
+    int GetPageCount() const;
+    int GetImageCount() const;
+
+    // CPU copy of a page, for checking the packing without a device
+    const std::vector<uint32_t>& GetPagePixels(int page) const { return pages[page]->pixels; }
+
+    // Uploads everything added since the last flush
+    void Flush();
+
+private:
+    struct Page {
+        int width = 0, height = 0;
+        std::vector<uint32_t> pixels;
+        SkylinePacker packer;
+        ID3D11ShaderResourceView* texture = nullptr;
+        int dirtyLeft = 0, dirtyTop = 0, dirtyRight = 0, dirtyBottom = 0;   // empty when right <= left
+    };
+
+    Page* AddPage(int width, int height);
+    void MarkDirty(Page& page, int x, int y, int w, int h);
+
+    IAtlasDevice* device;
+    int pageSize;
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<Page>> pages;
+    std::vector<AtlasRegion> regions;
+};
+
+class D3D11AtlasDevice : public IAtlasDevice {
+public:
+    D3D11AtlasDevice(ID3D11Device* device, ID3D11DeviceContext* context);
+
+    ID3D11ShaderResourceView* CreatePage(int width, int height) override;
+    void UpdatePage(ID3D11ShaderResourceView* page, int x, int y, int w, int h, const uint32_t* pixels, int pitch) override;
+    void ReleasePage(ID3D11ShaderResourceView* page) override;
+
+private:
+    ID3D11Device* device;
+    ID3D11DeviceContext* context;
+};
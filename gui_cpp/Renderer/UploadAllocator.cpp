@@ -0,0 +1,136 @@
+#include "UploadAllocator.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+UploadAllocator::UploadAllocator(IUploadDevice* dev, size_t initial, Mode m)
+    : device(dev), mode(m), initialCapacity(initial)
+{
+}
+
+void UploadAllocator::SetMode(Mode m)
+{
+    if (mode == m) return;
+    mode = m;
+    needDiscard = true;
+    head = 0;
+}
+
+size_t UploadAllocator::Upload(const void* data, size_t bytes, size_t alignment)
+{
+    if (bytes == 0) return 0;
+
+    // a ring should hold a few frames, otherwise it wraps (and discards) every frame
+    size_t required = (mode == Mode::Ring) ? (frameBytes + bytes) * RingFrames : bytes;
+    if (required > capacity) {
+        // with headroom, so the next slightly larger frame still fits; a
+        // device that refuses that much may still take the exact size
+        size_t newCapacity = std::max({ required + required / 2, capacity * 2, initialCapacity });
+        if (!Reallocate(newCapacity) && !Reallocate(required)) return Failed;
+    }
+
+    size_t offset = 0;
+    bool discard = needDiscard || mode == Mode::Discard;
+    if (mode == Mode::Ring && !discard) {
+        offset = (head + alignment - 1) / alignment * alignment;
+        if (offset + bytes > capacity) {
+            // wrap around, the GPU may still read the old contents
+            offset = 0;
+            discard = true;
+        }
+    }
+
+    uint8_t* dst = (uint8_t*)device->Map(discard);
+    if (!dst) return Failed;
+    memcpy(dst + offset, data, bytes);
+    device->Unmap();
+
+    if (discard) stats.discards++;
+    needDiscard = false;
+    head = offset + bytes;
+    frameBytes += bytes;
+    stats.bytesUploaded += bytes;
+    return offset;
+}
+
+void UploadAllocator::EndFrame()
+{
+    stats.frameBytes = frameBytes;
+
+    size_t needed = (mode == Mode::Ring) ? frameBytes * RingFrames : frameBytes;
+    frameBytes = 0;
+
+    // hysteresis: only shrink after a long run of frames using under a quarter
+    if (capacity > initialCapacity && needed * 4 < capacity) {
+        lowUsagePeak = std::max(lowUsagePeak, needed);
+        if (++lowUsageFrames >= ShrinkDelayFrames) {
+            Reallocate(std::max(initialCapacity, lowUsagePeak * 2));
+            lowUsageFrames = 0;
+            lowUsagePeak = 0;
+        }
+    }
+    else {
+        lowUsageFrames = 0;
+        lowUsagePeak = 0;
+    }
+}
+
+bool UploadAllocator::Reallocate(size_t newCapacity)
+{
+    head = 0;
+    needDiscard = true;
+
+    if (!device->Create(newCapacity)) {
+        capacity = 0;
+        stats.capacity = 0;
+        return false;
+    }
+
+    stats.reallocations++;
+    capacity = newCapacity;
+    stats.capacity = capacity;
+    return true;
+}
+
+D3D11UploadBuffer::D3D11UploadBuffer(ID3D11Device* dev, ID3D11DeviceContext* ctx, UINT flags)
+    : device(dev), context(ctx), bindFlags(flags)
+{
+}
+
+D3D11UploadBuffer::~D3D11UploadBuffer()
+{
+    if (buffer) buffer->Release();
+}
+
+bool D3D11UploadBuffer::Create(size_t bytes)
+{
+    if (buffer) { buffer->Release(); buffer = nullptr; }
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.ByteWidth = (UINT)bytes;
+    desc.BindFlags = bindFlags;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    HRESULT hr = device->CreateBuffer(&desc, nullptr, &buffer);
+    if (FAILED(hr)) {
+        std::cerr << "Failed to create upload buffer\n";
+        return false;
+    }
+    return true;
+}
+
+void* D3D11UploadBuffer::Map(bool discard)
+{
+    if (!buffer) return nullptr;
+
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    HRESULT hr = context->Map(buffer, 0, discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped);
+    if (FAILED(hr)) return nullptr;
+    return mapped.pData;
+}
+
+void D3D11UploadBuffer::Unmap()
+{
+    context->Unmap(buffer, 0);
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <d3d11.h>
+#include <cstdint>
+#include <cstddef>
+
+// Device side of a streaming buffer. Kept behind an interface so the
+// allocation policy in UploadAllocator can be driven by a fake device.
+class IUploadDevice {
+public:
+    virtual ~IUploadDevice() = default;
+
+    // (Re)creates the backing buffer with the given size in bytes. Previous
+    // contents are dropped.
+    virtual bool Create(size_t bytes) = 0;
+    // Maps the whole buffer for writing. discard = the old contents may still
+    // be in use by the GPU and must be renamed (WRITE_DISCARD), otherwise the
+    // caller promises not to touch bytes already handed out (WRITE_NO_OVERWRITE).
+    virtual void* Map(bool discard) = 0;
+    virtual void Unmap() = 0;
+};
+
+struct UploadStats {
+    uint64_t reallocations = 0;     // times the backing buffer was (re)created
+    uint64_t discards = 0;          // maps that renamed the buffer
+    uint64_t bytesUploaded = 0;     // total bytes copied into the buffer
+    uint64_t frameBytes = 0;        // bytes uploaded during the last finished frame
+    size_t capacity = 0;            // current size of the backing buffer
+};
+
+// Streams per-frame data into one dynamic buffer.
+//
+// The buffer grows geometrically, to at least 1.5x what is needed, and only
+// shrinks after its usage has stayed under a quarter of the capacity for
+// ShrinkDelayFrames frames in a row.
+// In Ring mode each upload is appended behind the previous one with
+// NO_OVERWRITE and the buffer is only discarded when it wraps, so several
+// frames of data live side by side. Discard mode renames the buffer on every
+// upload and always writes at offset 0.
+class UploadAllocator {
+public:
+    enum class Mode { Discard, Ring };
+
+    static constexpr size_t Failed = SIZE_MAX;
+    static constexpr size_t ShrinkDelayFrames = 120;
+    static constexpr size_t RingFrames = 3;     // frames of data a ring is sized for
+
+    UploadAllocator(IUploadDevice* device, size_t initialCapacity, Mode mode = Mode::Ring);
+
+    // Copies bytes into the buffer and returns the byte offset it landed at,
+    // or Failed. A reallocation invalidates offsets returned earlier in the
+    // same frame, so upload everything a draw needs together.
+    size_t Upload(const void* data, size_t bytes, size_t alignment = 16);
+
+    // Call once per frame after the last upload. Handles shrinking.
+    void EndFrame();
+
+    void SetMode(Mode m);
+    Mode GetMode() const { return mode; }
+    const UploadStats& GetStats() const { return stats; }
+
+private:
+    bool Reallocate(size_t newCapacity);
+
+    IUploadDevice* device;
+    Mode mode;
+    size_t initialCapacity;
+    size_t capacity = 0;
+    size_t head = 0;                // end of the last upload
+    bool needDiscard = true;        // fresh buffers are always mapped with discard
+    size_t frameBytes = 0;
+    size_t lowUsageFrames = 0;
+    size_t lowUsagePeak = 0;        // largest need seen during the current low streak
+    UploadStats stats;
+};
+
+// IUploadDevice on top of a D3D11 dynamic buffer.
+class D3D11UploadBuffer : public IUploadDevice {
+public:
+    D3D11UploadBuffer(ID3D11Device* device, ID3D11DeviceContext* context, UINT bindFlags);
+    ~D3D11UploadBuffer() override;
+
+    bool Create(size_t bytes) override;
+    void* Map(bool discard) override;
+    void Unmap() override;
+
+    ID3D11Buffer* GetBuffer() const { return buffer; }
+
+private:
+    ID3D11Device* device;
+    ID3D11DeviceContext* context;
+    UINT bindFlags;
+    ID3D11Buffer* buffer = nullptr;
+};
@@ -0,0 +1,74 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int threads)
+{
+    if (threads < 0) {
+        int hardware = (int)std::thread::hardware_concurrency();
+        threads = hardware > 1 ? hardware - 1 : 0;
+    }
+
+    for (int i = 0; i < threads; i++)
+        workers.emplace_back(&WorkerPool::WorkerLoop, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+
+    for (std::thread& t : workers)
+        t.join();
+}
+
+void WorkerPool::ParallelFor(int count, const std::function<void(int)>& fn)
+{
+    if (count <= 0) return;
+
+    if (workers.empty() || count == 1) {
+        for (int i = 0; i < count; i++) fn(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobCount = count;
+        nextIndex.store(0, std::memory_order_relaxed);
+        activeWorkers = (int)workers.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    RunJobs();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return activeWorkers == 0; });
+    job = nullptr;
+}
+
+void WorkerPool::RunJobs()
+{
+    for (int i = nextIndex.fetch_add(1); i < jobCount; i = nextIndex.fetch_add(1))
+        (*job)(i);
+}
+
+void WorkerPool::WorkerLoop()
+{
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return quit || generation != seen; });
+            if (quit) return;
+            seen = generation;
+        }
+
+        RunJobs();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--activeWorkers == 0) done.notify_one();
+    }
+}
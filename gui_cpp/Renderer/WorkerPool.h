@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+// Fixed set of worker threads for fork/join loops. The calling thread takes
+// part in every loop, so a pool with no workers simply runs serially.
+class WorkerPool {
+public:
+    // threads < 0: one less than the hardware threads
+    explicit WorkerPool(int threads = -1);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int GetThreadCount() const { return (int)workers.size(); }
+
+    // Calls fn(i) for every i in [0, count) in no particular order or thread
+    // and returns once all calls are done. Not reentrant.
+    void ParallelFor(int count, const std::function<void(int)>& fn);
+
+private:
+    void WorkerLoop();
+    void RunJobs();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    const std::function<void(int)>* job = nullptr;
+    int jobCount = 0;
+    std::atomic<int> nextIndex{ 0 };
+    int activeWorkers = 0;
+    uint64_t generation = 0;
+    bool quit = false;
+};
@@ -50,7 +50,7 @@ LRESULT CALLBACK FuserWndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
 	return 0;
 }
 
-Window::Window(const char name_[24], POINT size)
+Window::Window(const char name_[24], POINT size, bool partialRedraw)
 {
 	WNDCLASSEX windowclass = {};
 	windowclass.cbClsExtra = NULL;
@@ -93,10 +93,13 @@ Window::Window(const char name_[24], POINT size)
 	sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 	sd.SampleDesc.Count = 1U;
 	sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	sd.BufferCount = 2U;
+	// partial redraw needs the back buffer to keep its contents across
+	// Present, which only a single sequential buffer guarantees; everything
+	// else keeps the double-buffered chain
+	sd.BufferCount = partialRedraw ? 1U : 2U;
 	sd.OutputWindow = m_hwnd;
 	sd.Windowed = TRUE;
-	sd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+	sd.SwapEffect = partialRedraw ? DXGI_SWAP_EFFECT_SEQUENTIAL : DXGI_SWAP_EFFECT_DISCARD;
 	sd.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
 
 	constexpr D3D_FEATURE_LEVEL levels[2]
@@ -137,6 +140,9 @@ Window::Window(const char name_[24], POINT size)
 
 	renderer->SetHWND(m_hwnd);
 	renderer->SetWindowSize(size.x, size.y);
+	renderer->SetRenderTarget(render_target_view);
+	renderer->SetPartialRedraw(partialRedraw);
+	renderer->SetPresentCallback([this]() { swap_chain->Present(1, 0); });
 
 	b_is_run = true;
 }
@@ -160,6 +166,11 @@ void Window::onResize(UINT width, UINT height)
 	size.y = height;
 
 	if (device) {
+		// the render thread may still be drawing into the old buffers
+		if (renderer) {
+			renderer->WaitForRenderThread();
+			renderer->SetRenderTarget(nullptr);
+		}
 		if (render_target_view) { render_target_view->Release(); render_target_view = nullptr; }
 		swap_chain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, 0);
 		ID3D11Texture2D* pBackBuffer;
@@ -167,8 +178,10 @@ void Window::onResize(UINT width, UINT height)
 		device->CreateRenderTargetView(pBackBuffer, nullptr, &render_target_view);
 		pBackBuffer->Release();
 
-		if (renderer)
+		if (renderer) {
 			renderer->SetWindowSize(width, height);
+			renderer->SetRenderTarget(render_target_view);
+		}
 	}
 }
 
@@ -187,9 +200,8 @@ void Window::onDestroy()
 
 void Window::onUpdate()
 {
-	constexpr float color[4]{ 0.f, 0.f, 0.f, 1.f };
-	device_context->OMSetRenderTargets(1U, &render_target_view, nullptr);
-	device_context->ClearRenderTargetView(render_target_view, color);
+	// binding and clearing the target is left to the renderer, which may do it
+	// on its render thread and only clears what it redraws
 }
 
 bool Window::broadcast()
@@ -230,11 +242,23 @@ void Window::displayFPS()
 	float x = size.x - textWidth - 10.0f;
 	float y = 10.0f;
 
+	int channel = renderer->GetChannel();
+	renderer->SetChannel(OverlayChannel);
 	renderer->AddText(x, y, fpsText.c_str(), Color(1.f, 1.f, 1.f, 1.f));
+	renderer->SetChannel(channel);
 }
 
 void Window::present()
 {
+	// nothing changed: keep the image on screen and sleep until input arrives
+	// (or the timeout, so timers such as the FPS counter still tick)
+	if (renderer && renderer->IsFrameElided()) {
+		MsgWaitForMultipleObjects(0, nullptr, FALSE, idleWaitMs, QS_ALLINPUT);
+		return;
+	}
+
+	// the render thread presents its frames itself
+	if (renderer && renderer->IsThreadedRendering()) return;
 	swap_chain->Present(1, 0);
 }
 
@@ -13,7 +13,9 @@ class Window
 {
 
 public:
-	Window(const char name_[24], POINT size);
+	// partialRedraw creates a swap chain that keeps the back buffer, so the
+	// renderer only redraws what changed
+	Window(const char name_[24], POINT size, bool partialRedraw = false);
 	~Window();
 
 	bool release();
@@ -39,4 +41,5 @@ private:
 	IDXGISwapChain* swap_chain{ nullptr };
 	ID3D11RenderTargetView* render_target_view{ nullptr };
 	D3D_FEATURE_LEVEL level{};
+	DWORD idleWaitMs = 16;			// longest wait for input on an elided frame
 };
\ No newline at end of file
@@ -28,6 +28,8 @@ int main()
     };
 
     std::vector<Shape> shapes;
+    std::vector<Rect> shapeRects;
+    std::vector<uint32_t> shapeColors;
 
     while (window.isRun())
     {
@@ -85,10 +87,14 @@ int main()
         ui.EndWindow();
 
 
-        // Render Shapes
+        // Render Shapes, one bulk call for all of them
+        shapeRects.clear();
+        shapeColors.clear();
         for (auto& s : shapes) {
-            renderer->AddRectangleFilled({ s.x, s.y }, { s.size, s.size }, { s.r, s.g, s.b, 1.f });
+            shapeRects.push_back({ s.x, s.y, s.x + s.size, s.y + s.size });
+            shapeColors.push_back(Color(s.r, s.g, s.b, 1.f).ToRGBA8());
         }
+        renderer->AddRectsFilled(shapeRects, shapeColors);
 
 
         // End Frame
@@ -0,0 +1,159 @@
+#include "Test.h"
+#include "BulkKernels.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+// Scalar, SSE2 and, when the CPU has it, AVX2 must write the same bytes,
+// untouched parts of the buffers included
+static std::vector<SimdLevel> Levels()
+{
+    std::vector<SimdLevel> levels = { SimdLevel::Scalar, SimdLevel::SSE2 };
+    if (DetectSimdLevel() == SimdLevel::AVX2) levels.push_back(SimdLevel::AVX2);
+    return levels;
+}
+
+constexpr uint16_t BaseIndex = 100;
+const Rect clip = { 0.f, 0.f, 400.f, 300.f };
+const float NaN = std::numeric_limits<float>::quiet_NaN();
+
+struct KernelOutput {
+    size_t written = 0;
+    std::vector<Vertex> vtx;
+    std::vector<uint16_t> idx;
+};
+
+template <typename Expand>
+static KernelOutput Run(size_t count, Expand expand)
+{
+    KernelOutput out;
+    out.vtx.resize(count * 4);
+    out.idx.resize(count * 6);
+    memset(out.vtx.data(), 0xab, out.vtx.size() * sizeof(Vertex));
+    memset(out.idx.data(), 0xab, out.idx.size() * sizeof(uint16_t));
+    out.written = expand(out.vtx.data(), out.idx.data());
+    return out;
+}
+
+static bool SameOutput(const KernelOutput& a, const KernelOutput& b)
+{
+    return a.written == b.written &&
+        memcmp(a.vtx.data(), b.vtx.data(), a.vtx.size() * sizeof(Vertex)) == 0 &&
+        memcmp(a.idx.data(), b.idx.data(), a.idx.size() * sizeof(uint16_t)) == 0;
+}
+
+// Groups of eight where every pattern appears: all inside, all outside,
+// mixed, straddling the clip edge, and NaN in every coordinate
+static std::vector<Vec2> TestPoints(size_t count, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> x(-60.f, 460.f), y(-60.f, 360.f), inside(20.f, 280.f);
+    std::vector<Vec2> points(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t group = i / 8 % 4;
+        if (group == 0) points[i] = { inside(rng), inside(rng) };
+        else if (group == 1) points[i] = { -200.f - i, 500.f + i };
+        else points[i] = { x(rng), y(rng) };
+
+        if (i % 13 == 5) points[i].x = NaN;
+        if (i % 17 == 7) points[i].y = NaN;
+        if (i % 19 == 3) points[i] = { 400.f, 150.f };     // on the right edge
+    }
+    return points;
+}
+
+static std::vector<uint32_t> TestColors(size_t count)
+{
+    std::vector<uint32_t> colors(count);
+    for (size_t i = 0; i < count; i++) colors[i] = 0xff000000u | (uint32_t)(i * 0x010203u);
+    return colors;
+}
+
+TEST(BulkKernelsRectsMatchAcrossLevels)
+{
+    std::mt19937 rng(1);
+    for (size_t count : { (size_t)1, (size_t)3, (size_t)8, (size_t)13, (size_t)64, (size_t)203 }) {
+        std::vector<Vec2> corners = TestPoints(count * 2, rng);
+        std::vector<Rect> rects(count);
+        for (size_t i = 0; i < count; i++) {
+            Vec2 a = corners[2 * i], b = corners[2 * i + 1];
+            rects[i] = { a.x, a.y, a.x + std::fabs(b.x - a.x) * 0.2f, a.y + std::fabs(b.y - a.y) * 0.2f };
+            if (i % 11 == 4) rects[i].right = rects[i].left;     // empty
+        }
+        std::vector<uint32_t> colors = TestColors(count);
+
+        for (size_t stride : { (size_t)0, (size_t)1 }) {
+            KernelOutput reference;
+            for (SimdLevel level : Levels()) {
+                KernelOutput out = Run(count, [&](Vertex* vtx, uint16_t* idx) {
+                    return ExpandRects(level, rects.data(), count, colors.data(), stride, clip, BaseIndex, vtx, idx);
+                });
+                if (level == SimdLevel::Scalar) reference = out;
+                else CHECK(SameOutput(reference, out));
+            }
+            CHECK(reference.written > 0 || count < 8);
+        }
+    }
+}
+
+TEST(BulkKernelsPointsMatchAcrossLevels)
+{
+    std::mt19937 rng(2);
+    for (size_t count : { (size_t)1, (size_t)5, (size_t)8, (size_t)31, (size_t)64, (size_t)199 }) {
+        std::vector<Vec2> points = TestPoints(count, rng);
+        std::vector<uint32_t> colors = TestColors(count);
+
+        for (size_t stride : { (size_t)0, (size_t)1 }) {
+            KernelOutput reference;
+            for (SimdLevel level : Levels()) {
+                KernelOutput out = Run(count, [&](Vertex* vtx, uint16_t* idx) {
+                    return ExpandPoints(level, points.data(), count, colors.data(), stride, 2.5f, clip, BaseIndex, vtx, idx);
+                });
+                if (level == SimdLevel::Scalar) reference = out;
+                else CHECK(SameOutput(reference, out));
+            }
+        }
+    }
+}
+
+TEST(BulkKernelsLinesMatchAcrossLevels)
+{
+    std::mt19937 rng(3);
+    for (size_t count : { (size_t)1, (size_t)6, (size_t)8, (size_t)29, (size_t)64, (size_t)211 }) {
+        std::vector<Vec2> endpoints = TestPoints(count * 2, rng);
+        for (size_t i = 0; i < count; i += 7) endpoints[2 * i + 1] = endpoints[2 * i];     // zero length
+        std::vector<uint32_t> colors = TestColors(count);
+
+        for (size_t stride : { (size_t)0, (size_t)1 }) {
+            KernelOutput reference;
+            for (SimdLevel level : Levels()) {
+                KernelOutput out = Run(count, [&](Vertex* vtx, uint16_t* idx) {
+                    return ExpandLines(level, endpoints.data(), count, colors.data(), stride, 1.5f, clip, BaseIndex, vtx, idx);
+                });
+                if (level == SimdLevel::Scalar) reference = out;
+                else CHECK(SameOutput(reference, out));
+            }
+        }
+    }
+}
+
+// The skip rules themselves, at every level
+TEST(BulkKernelsSkipOutsideNaNAndZeroLength)
+{
+    const Vec2 endpoints[8] = {
+        { 10.f, 10.f }, { 50.f, 10.f },         // drawn
+        { 20.f, 20.f }, { 20.f, 20.f },         // zero length
+        { -50.f, -50.f }, { -20.f, -40.f },     // outside
+        { NaN, 10.f }, { 30.f, 30.f },          // NaN
+    };
+    const uint32_t color = 0xffffffff;
+    for (SimdLevel level : Levels()) {
+        KernelOutput out = Run(4, [&](Vertex* vtx, uint16_t* idx) {
+            return ExpandLines(level, endpoints, 4, &color, 0, 1.f, clip, BaseIndex, vtx, idx);
+        });
+        CHECK(out.written == 1);
+        CHECK(out.idx[0] == BaseIndex && out.idx[4] == BaseIndex + 3);
+        CHECK(out.vtx[0].x == 10.f && out.vtx[0].y == 11.f);
+    }
+}
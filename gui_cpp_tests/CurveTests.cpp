@@ -0,0 +1,93 @@
+#include "Test.h"
+#include "Renderer.h"
+#include "DrawBlock.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static float SegmentDistance(Vec2 p, Vec2 a, Vec2 b)
+{
+    float dx = b.x - a.x, dy = b.y - a.y;
+    float lenSq = dx * dx + dy * dy;
+    float t = lenSq > 0.f ? std::clamp(((p.x - a.x) * dx + (p.y - a.y) * dy) / lenSq, 0.f, 1.f) : 0.f;
+    float ex = a.x + dx * t - p.x, ey = a.y + dy * t - p.y;
+    return std::sqrt(ex * ex + ey * ey);
+}
+
+// Largest distance from densely sampled curve points to the polyline
+template <typename Curve>
+static float MaxDeviation(const std::vector<Vec2>& polyline, Curve curve)
+{
+    float worst = 0.f;
+    for (int i = 0; i <= 2000; i++) {
+        Vec2 p = curve(i / 2000.f);
+        float best = 1e9f;
+        for (size_t k = 0; k + 1 < polyline.size(); k++)
+            best = std::min(best, SegmentDistance(p, polyline[k], polyline[k + 1]));
+        worst = std::max(worst, best);
+    }
+    return worst;
+}
+
+// The points the flattener produces, recorded into a block so the path can
+// be read back
+static std::vector<Vec2> FlattenedPath(Renderer& renderer, Vec2 p1, const Vec2* controls, int count)
+{
+    DrawBlock block;
+    renderer.BeginBlock(block);
+    renderer.PathClear();
+    renderer.PathLineTo(p1);
+    if (count == 2) renderer.PathBezierQuadraticTo(controls[0], controls[1]);
+    else renderer.PathBezierCubicTo(controls[0], controls[1], controls[2]);
+    std::vector<Vec2> path = block.GetList().path;
+    renderer.PathClear();
+    renderer.EndBlock(block);
+    return path;
+}
+
+// The tolerance bounds the distance between curve and polyline, and is used
+// up: the worst segment is more than a quarter of it away, subdividing one
+// level less would have exceeded it
+TEST(CurveQuadraticUsesTolerance)
+{
+    Renderer renderer(nullptr, nullptr);
+    const Vec2 p1 = { 10.f, 200.f };
+    const Vec2 controls[2] = { { 150.f, -120.f }, { 400.f, 180.f } };
+    auto curve = [&](float t) {
+        float u = 1.f - t;
+        return Vec2{ u * u * p1.x + 2.f * u * t * controls[0].x + t * t * controls[1].x,
+                     u * u * p1.y + 2.f * u * t * controls[0].y + t * t * controls[1].y };
+    };
+
+    const float tolerances[4] = { 0.1f, 0.25f, 0.5f, 2.f };
+    size_t lastCount = SIZE_MAX;
+    for (float tolerance : tolerances) {
+        renderer.SetCurveTolerance(tolerance);
+        std::vector<Vec2> path = FlattenedPath(renderer, p1, controls, 2);
+        float deviation = MaxDeviation(path, curve);
+        CHECK(deviation <= tolerance * 1.01f);
+        CHECK(deviation > tolerance * 0.25f);
+        CHECK(path.size() < lastCount);
+        lastCount = path.size();
+    }
+}
+
+TEST(CurveCubicStaysWithinTolerance)
+{
+    Renderer renderer(nullptr, nullptr);
+    const Vec2 p1 = { 10.f, 100.f };
+    const Vec2 controls[3] = { { 80.f, -150.f }, { 300.f, 350.f }, { 380.f, 60.f } };
+    auto curve = [&](float t) {
+        float u = 1.f - t;
+        float w1 = u * u * u, w2 = 3.f * u * u * t, w3 = 3.f * u * t * t, w4 = t * t * t;
+        return Vec2{ w1 * p1.x + w2 * controls[0].x + w3 * controls[1].x + w4 * controls[2].x,
+                     w1 * p1.y + w2 * controls[0].y + w3 * controls[1].y + w4 * controls[2].y };
+    };
+
+    const float tolerances[3] = { 0.1f, 0.5f, 2.f };
+    for (float tolerance : tolerances) {
+        renderer.SetCurveTolerance(tolerance);
+        CHECK(MaxDeviation(FlattenedPath(renderer, p1, controls, 3), curve) <= tolerance * 1.01f);
+    }
+}
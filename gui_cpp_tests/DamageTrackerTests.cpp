@@ -0,0 +1,164 @@
+#include "Test.h"
+#include "DamageTracker.h"
+
+// One command per rect: each gets its own clip, which is also its bounds
+static void AddRect(DrawList& list, const Rect& r, uint32_t col = 0xffffffff)
+{
+    list.PushClipRect(r, false);
+    list.PrimReserve(4, 6);
+    list.PrimRect({ r.left, r.top }, { r.right, r.bottom }, col);
+    list.PopClipRect();
+}
+
+static bool HasDirtyRect(const DamageTracker& damage, const Rect& r)
+{
+    for (const Rect& dirty : damage.GetDirtyRects())
+        if (dirty == r) return true;
+    return false;
+}
+
+TEST(DamageFirstFrameIsFullRedraw)
+{
+    DamageTracker damage;
+    DrawList list;
+    AddRect(list, { 10.f, 10.f, 50.f, 50.f });
+
+    damage.Update(list, 400, 300);
+    CHECK(damage.IsFullRedraw());
+    CHECK(damage.GetDirtyRects().empty());
+
+    damage.Update(list, 400, 300);
+    CHECK(damage.IsClean());
+
+    // a resize or an explicit invalidation starts over
+    damage.Update(list, 500, 300);
+    CHECK(damage.IsFullRedraw());
+    damage.Invalidate();
+    damage.Update(list, 500, 300);
+    CHECK(damage.IsFullRedraw());
+}
+
+TEST(DamageOnlyChangedCommands)
+{
+    DamageTracker damage;
+    const Rect a = { 10.f, 10.f, 50.f, 50.f };
+    const Rect b = { 100.f, 10.f, 140.f, 50.f };
+    const Rect c = { 200.f, 10.f, 240.f, 50.f };
+
+    DrawList list;
+    AddRect(list, a);
+    AddRect(list, b);
+    AddRect(list, c);
+    damage.Update(list, 400, 300);
+
+    // only b's colour changes
+    list.Clear();
+    AddRect(list, a);
+    AddRect(list, b, 0xff0000ff);
+    AddRect(list, c);
+    damage.Update(list, 400, 300);
+    CHECK(!damage.IsFullRedraw());
+    CHECK(damage.GetDirtyRects().size() == 1);
+    CHECK(HasDirtyRect(damage, b));
+    CHECK(damage.GetDirtyArea() == 40.f * 40.f);
+
+    // c disappears: its old bounds are damaged
+    list.Clear();
+    AddRect(list, a);
+    AddRect(list, b, 0xff0000ff);
+    damage.Update(list, 400, 300);
+    CHECK(damage.GetDirtyRects().size() == 1);
+    CHECK(HasDirtyRect(damage, c));
+
+    // a moves: old and new bounds
+    const Rect moved = { 10.f, 100.f, 50.f, 140.f };
+    list.Clear();
+    AddRect(list, moved);
+    AddRect(list, b, 0xff0000ff);
+    damage.Update(list, 400, 300);
+    CHECK(damage.GetDirtyRects().size() == 2);
+    CHECK(HasDirtyRect(damage, a));
+    CHECK(HasDirtyRect(damage, moved));
+}
+
+TEST(DamageStackingOrder)
+{
+    DamageTracker damage;
+    const Rect back = { 10.f, 10.f, 60.f, 60.f };
+    const Rect front = { 40.f, 40.f, 90.f, 90.f };
+
+    DrawList list;
+    AddRect(list, back, 0xff0000ff);
+    AddRect(list, front, 0xff00ff00);
+    damage.Update(list, 400, 300);
+
+    // same commands, back now drawn last: it is the one that changed on screen
+    list.Clear();
+    AddRect(list, front, 0xff00ff00);
+    AddRect(list, back, 0xff0000ff);
+    damage.Update(list, 400, 300);
+    CHECK(!damage.IsFullRedraw());
+    CHECK(damage.GetDirtyRects().size() == 1);
+    CHECK(HasDirtyRect(damage, back));
+}
+
+TEST(DamageMergesOverlappingAndExcessRects)
+{
+    DamageTracker damage;
+    damage.SetFullRedrawThreshold(1.f);
+    DrawList list;
+    damage.Update(list, 1000, 1000);
+
+    // two overlapping new rects become their union
+    AddRect(list, { 10.f, 10.f, 50.f, 50.f });
+    AddRect(list, { 30.f, 30.f, 80.f, 70.f });
+    damage.Update(list, 1000, 1000);
+    CHECK(damage.GetDirtyRects().size() == 1);
+    CHECK(HasDirtyRect(damage, { 10.f, 10.f, 80.f, 70.f }));
+
+    // more disjoint rects than MaxRects collapse into one covering them all
+    list.Clear();
+    damage.Update(list, 1000, 1000);
+    for (int i = 0; i < DamageTracker::MaxRects + 2; i++) {
+        float x = 20.f + i * 30.f;
+        AddRect(list, { x, 100.f + i, x + 10.f, 110.f + i });
+    }
+    damage.Update(list, 1000, 1000);
+    CHECK(!damage.IsFullRedraw());
+    CHECK(damage.GetDirtyRects().size() == 1);
+    float lastX = 20.f + (DamageTracker::MaxRects + 1) * 30.f;
+    CHECK(HasDirtyRect(damage, { 20.f, 100.f, lastX + 10.f, 110.f + DamageTracker::MaxRects + 1 }));
+
+    // exactly MaxRects disjoint ones are kept apart
+    list.Clear();
+    damage.Update(list, 1000, 1000);
+    for (int i = 0; i < DamageTracker::MaxRects; i++) {
+        float x = 20.f + i * 30.f;
+        AddRect(list, { x, 100.f, x + 10.f, 110.f });
+    }
+    damage.Update(list, 1000, 1000);
+    CHECK((int)damage.GetDirtyRects().size() == DamageTracker::MaxRects);
+}
+
+TEST(DamageFullRedrawThreshold)
+{
+    // 100 x 100 viewport, the default threshold is 0.6 of it
+    DamageTracker damage;
+    DrawList list;
+    damage.Update(list, 100, 100);
+
+    AddRect(list, { 0.f, 0.f, 100.f, 59.f });
+    damage.Update(list, 100, 100);
+    CHECK(!damage.IsFullRedraw());
+    CHECK(damage.GetDirtyArea() == 5900.f);
+
+    list.Clear();
+    damage.Update(list, 100, 100);
+    CHECK(!damage.IsFullRedraw());
+
+    AddRect(list, { 0.f, 0.f, 100.f, 61.f });
+    damage.Update(list, 100, 100);
+    CHECK(damage.IsFullRedraw());
+    CHECK(damage.GetDirtyRects().empty());
+    CHECK(damage.GetDirtyArea() == 10000.f);
+}
@@ -0,0 +1,139 @@
+#include "Test.h"
+#include "DepthOrder.h"
+#include "RenderBackend.h"
+
+constexpr uint32_t Solid = 0xff808080;
+constexpr uint32_t HalfAlpha = 0x80808080;
+
+static void AddRect(DrawList& list, Rect r, uint32_t col)
+{
+    list.PrimReserve(4, 6);
+    list.PrimRect({ r.left, r.top }, { r.right, r.bottom }, col);
+}
+
+// a glyph quad: default texture, uvs away from the white texel
+static void AddGlyph(DrawList& list, Rect r, uint32_t col = 0xffffffff)
+{
+    list.PrimReserve(4, 6);
+    list.PrimRectUV({ r.left, r.top }, { r.right, r.bottom }, { 0.5f, 0.5f }, { 0.6f, 0.6f }, col);
+}
+
+TEST(DepthOrderClassifiesRuns)
+{
+    DrawList list;
+    AddRect(list, { 0.f, 0.f, 100.f, 100.f }, Solid);            // panel
+    AddGlyph(list, { 10.f, 10.f, 18.f, 20.f });                  // its text, same command
+    AddGlyph(list, { 18.f, 10.f, 26.f, 20.f });
+    AddRect(list, { 10.f, 30.f, 90.f, 50.f }, Solid);            // button, same command
+    AddRect(list, { 10.f, 60.f, 90.f, 80.f }, HalfAlpha);        // blended, same command
+    list.AddRectInstance({ 0.f, 120.f, 50.f, 20.f, Solid, 0.f });
+    list.AddRectInstance({ 60.f, 120.f, 50.f, 20.f, HalfAlpha, 0.f });
+    list.AddShapeInstance({ 0.f, 150.f, 20.f, 20.f, Solid, 10.f, 0.f });
+    int image = 0;
+    list.SetTexture((ID3D11ShaderResourceView*)&image);
+    AddRect(list, { 0.f, 180.f, 20.f, 200.f }, Solid);
+    list.SetTexture(nullptr);
+    CHECK(list.GetCommandCount() == 4);
+
+    DepthOrder order;
+    order.Build(list);
+
+    // panel and button stay opaque though text is in their command
+    const std::vector<DepthRun>& opaque = order.GetOpaque();
+    const std::vector<DepthRun>& translucent = order.GetTranslucent();
+    CHECK(opaque.size() == 2);
+    CHECK(translucent.size() == 5);
+
+    // front to back: the button, then the panel
+    CHECK(opaque[0].command == 0 && opaque[0].idxOffset == 18 && opaque[0].elemCount == 6);
+    CHECK(opaque[1].command == 0 && opaque[1].idxOffset == 0 && opaque[1].elemCount == 6);
+
+    // painter's order: both glyphs in one run, the blended rect, the rect
+    // instances (one translucent instance makes the command translucent),
+    // the shape and the image
+    CHECK(translucent[0].command == 0 && translucent[0].idxOffset == 6 && translucent[0].elemCount == 12);
+    CHECK(translucent[1].command == 0 && translucent[1].idxOffset == 24 && translucent[1].elemCount == 6);
+    CHECK(translucent[2].command == 1);
+    CHECK(translucent[3].command == 2);
+    CHECK(translucent[4].command == 3);
+
+    const DepthOrderStats& stats = order.GetStats();
+    CHECK(stats.opaqueRuns == 2);
+    CHECK(stats.translucentRuns == 5);
+    CHECK(stats.opaqueTriangles == 4);
+    CHECK(stats.translucentTriangles == 4 + 2 + 2 * 2 + 2 + 2);
+
+    // a slice draws exactly its indices
+    DrawCommand glyphs = DepthOrder::Slice(list, translucent[0]);
+    CHECK(glyphs.idxOffset == 6 && glyphs.elemCount == 12 && glyphs.vtxOffset == list.cmdBuffer[0].vtxOffset);
+    DrawCommand rects = DepthOrder::Slice(list, translucent[2]);
+    CHECK(rects.instCount == 2 && rects.instOffset == 0);
+}
+
+TEST(DepthOrderAssignsDepthsInListOrder)
+{
+    DrawList list;
+    for (int i = 0; i < 5; i++) {
+        float x = i * 10.f;
+        AddRect(list, { x, 0.f, x + 20.f, 20.f }, Solid);
+        AddGlyph(list, { x, 0.f, x + 5.f, 5.f });
+    }
+
+    DepthOrder order;
+    order.Build(list);
+    CHECK(order.GetOpaque().size() == 5);
+    CHECK(order.GetTranslucent().size() == 5);
+
+    // run k of n is at 1 - (k + 1) / (n + 1), later runs nearer
+    std::vector<DepthRun> all;
+    for (const DepthRun& run : order.GetOpaque()) all.push_back(run);
+    for (const DepthRun& run : order.GetTranslucent()) all.push_back(run);
+    bool spaced = true;
+    for (const DepthRun& run : all) {
+        int k = (int)(run.idxOffset / 6);
+        spaced &= run.depth == (float)(1.0 - (k + 1) / 11.0);
+        spaced &= run.depth > 0.f && run.depth < 1.f;
+    }
+    CHECK(spaced);
+
+    // opaque front to back, translucent back to front
+    for (size_t i = 1; i < order.GetOpaque().size(); i++)
+        CHECK(order.GetOpaque()[i].depth > order.GetOpaque()[i - 1].depth);
+    for (size_t i = 1; i < order.GetTranslucent().size(); i++)
+        CHECK(order.GetTranslucent()[i].depth < order.GetTranslucent()[i - 1].depth);
+
+    // same list, same result
+    DepthOrder again;
+    again.Build(list);
+    CHECK(again.GetOpaque().size() == order.GetOpaque().size());
+    CHECK(again.GetOpaque()[0].depth == order.GetOpaque()[0].depth);
+}
+
+TEST(DepthOrderReportsAvoidedOverdraw)
+{
+    // two stacked panels with text, all in one command
+    DrawList list;
+    AddRect(list, { 0.f, 0.f, 40.f, 40.f }, 0xff0000ff);
+    AddGlyph(list, { 2.f, 2.f, 8.f, 8.f }, 0xffffffff);
+    AddRect(list, { 10.f, 10.f, 30.f, 30.f }, 0xff00ff00);
+    AddGlyph(list, { 12.f, 12.f, 16.f, 16.f }, 0x80ffffff);
+
+    SoftwareBackend painter, depth;
+    depth.SetDepthPass(true);
+    painter.RenderFrame(list, 64, 64);
+    depth.RenderFrame(list, 64, 64);
+
+    // the same picture
+    CHECK(painter.GetPixels() == depth.GetPixels());
+
+    // painter's order shades every pixel of everything
+    CHECK(painter.GetPixelsShaded() == 1600 + 36 + 400 + 16);
+    CHECK(painter.GetPixelsRejected() == 0);
+
+    // front panel first, so 400 pixels of the back one are rejected, and
+    // the first glyph is not covered
+    CHECK(depth.GetPixelsRejected() == 400);
+    CHECK(depth.GetPixelsShaded() == 1600 + 36 + 16);
+    CHECK(depth.GetDepthOrderStats().opaqueRuns == 2);
+    CHECK(depth.GetDepthOrderStats().translucentRuns == 2);
+}
@@ -0,0 +1,226 @@
+#include "Test.h"
+#include "DynamicTexture.h"
+
+#include <cstring>
+
+// Staging copies in CPU memory with a padded row pitch, a texture the copies
+// land in and a switch per copy that makes it look still in use by the GPU
+class FakeStagingDevice : public IStagingDevice {
+public:
+    static constexpr uint8_t Untouched = 0xcd;
+    static constexpr size_t PitchPadding = 40;
+
+    struct Copy { int slot, x, y, w, h; };
+
+    bool Create(int w, int h, int stagingCount) override {
+        width = w;
+        height = h;
+        pitch = w * sizeof(uint32_t) + PitchPadding;
+        staging.assign(stagingCount, std::vector<uint8_t>(pitch * h, Untouched));
+        busy.assign(stagingCount, false);
+        texture.assign((size_t)w * h, 0);
+        return true;
+    }
+
+    void* MapStaging(int slot, size_t& rowPitch) override {
+        if (busy[slot]) return nullptr;
+        rowPitch = pitch;
+        return staging[slot].data();
+    }
+
+    void UnmapStaging(int slot) override {}
+
+    void CopyStaging(int slot, int x, int y, int w, int h) override {
+        copies.push_back({ slot, x, y, w, h });
+        for (int row = y; row < y + h; row++)
+            memcpy(&texture[(size_t)row * width + x], staging[slot].data() + row * pitch + x * sizeof(uint32_t), w * sizeof(uint32_t));
+    }
+
+    ID3D11ShaderResourceView* GetView() const override { return nullptr; }
+
+    void ResetStaging() {
+        for (std::vector<uint8_t>& copy : staging) std::fill(copy.begin(), copy.end(), Untouched);
+    }
+
+    int width = 0, height = 0;
+    size_t pitch = 0;
+    std::vector<std::vector<uint8_t>> staging;
+    std::vector<bool> busy;
+    std::vector<uint32_t> texture;
+    std::vector<Copy> copies;
+};
+
+static bool SameCopy(const FakeStagingDevice::Copy& c, int x, int y, int w, int h)
+{
+    return c.x == x && c.y == y && c.w == w && c.h == h;
+}
+
+static std::vector<uint32_t> Pattern(int width, int height, uint32_t seed)
+{
+    std::vector<uint32_t> pixels((size_t)width * height);
+    for (size_t i = 0; i < pixels.size(); i++) pixels[i] = (uint32_t)i * 2654435761u + seed;
+    return pixels;
+}
+
+TEST(DynamicTextureFirstFlushUploadsEverything)
+{
+    FakeStagingDevice device;
+    DynamicTexture texture(&device, 32, 16);
+    CHECK(texture.IsDirty());
+
+    CHECK(texture.Flush());
+    CHECK(device.copies.size() == 1);
+    CHECK(SameCopy(device.copies[0], 0, 0, 32, 16));
+    CHECK(!texture.IsDirty());
+    CHECK(!texture.Flush());
+    CHECK(device.copies.size() == 1);
+}
+
+TEST(DynamicTextureDirtyRectIsClippedAndUnited)
+{
+    FakeStagingDevice device;
+    DynamicTexture texture(&device, 32, 16);
+    texture.Flush();
+    std::vector<uint32_t> pixels = Pattern(32, 16, 7);
+
+    // entirely outside: nothing to do
+    texture.Update(pixels.data(), 32, 40, 2, 4, 4);
+    texture.Update(pixels.data(), 32, -8, -8, 8, 8);
+    CHECK(!texture.IsDirty());
+
+    // hangs over the top-left corner, clipped to 0, 0, 3, 3
+    texture.Update(pixels.data(), 32, -2, -3, 5, 6);
+    CHECK(texture.IsDirty());
+    CHECK(texture.GetImage()[0] == pixels[0]);
+    CHECK(texture.GetImage()[2 * 32 + 2] == pixels[2 * 32 + 2]);
+    CHECK(texture.GetImage()[3 * 32 + 3] == 0);
+
+    // a second block grows the dirty rect to the bounding box of both, even
+    // past the right and bottom edges
+    texture.Update(pixels.data(), 32, 20, 10, 20, 20);
+    CHECK(texture.Flush());
+    CHECK(device.copies.size() == 2);
+    CHECK(SameCopy(device.copies[1], 0, 0, 32, 16));
+
+    texture.Update(pixels.data(), 32, 4, 5, 2, 2);
+    texture.Update(pixels.data(), 32, 10, 1, 3, 1);
+    CHECK(texture.Flush());
+    CHECK(SameCopy(device.copies[2], 4, 1, 9, 6));
+    CHECK(device.texture == texture.GetImage());
+}
+
+TEST(DynamicTextureFlushStagesOnlyDirtyBlock)
+{
+    const int width = 24, height = 12;
+    FakeStagingDevice device;
+    DynamicTexture texture(&device, width, height);
+    texture.Flush();
+    device.ResetStaging();
+    DynamicTextureStats before = texture.GetStats();
+
+    std::vector<uint32_t> pixels = Pattern(width, height, 3);
+    texture.Update(pixels.data(), width, 5, 3, 7, 4);
+    CHECK(texture.Flush());
+
+    const FakeStagingDevice::Copy& copy = device.copies.back();
+    CHECK(SameCopy(copy, 5, 3, 7, 4));
+
+    // inside the block the staging copy holds the image at the mapped pitch,
+    // every other byte, the padding included, was never written
+    const std::vector<uint8_t>& staged = device.staging[copy.slot];
+    bool blockMatches = true, restUntouched = true;
+    for (int row = 0; row < height; row++) {
+        for (size_t byte = 0; byte < device.pitch; byte++) {
+            int column = (int)(byte / sizeof(uint32_t));
+            bool inside = row >= 3 && row < 7 && column >= 5 && column < 12 && byte < width * sizeof(uint32_t);
+            uint8_t value = staged[row * device.pitch + byte];
+            if (inside) {
+                uint32_t pixel = pixels[(size_t)row * width + column];
+                blockMatches &= value == ((const uint8_t*)&pixel)[byte % sizeof(uint32_t)];
+            }
+            else {
+                restUntouched &= value == FakeStagingDevice::Untouched;
+            }
+        }
+    }
+    CHECK(blockMatches);
+    CHECK(restUntouched);
+    CHECK(device.texture == texture.GetImage());
+
+    DynamicTextureStats stats = texture.GetStats();
+    CHECK(stats.uploads == before.uploads + 1);
+    CHECK(stats.rowsStaged == before.rowsStaged + 4);
+    CHECK(stats.bytesStaged == before.bytesStaged + 7 * 4 * sizeof(uint32_t));
+    CHECK(stats.bytesCopied == before.bytesCopied + 7 * 4 * sizeof(uint32_t));
+}
+
+TEST(DynamicTextureSkipsBusyStagingCopies)
+{
+    FakeStagingDevice device;
+    DynamicTexture texture(&device, 8, 8);
+    CHECK(texture.Flush());
+    CHECK(device.copies.back().slot == 0);
+    std::vector<uint32_t> pixels = Pattern(8, 8, 11);
+
+    // the next copy in the ring is busy: passed over, the one after is used
+    device.busy[1] = true;
+    texture.Update(pixels.data(), 8, 0, 0, 2, 2);
+    CHECK(texture.Flush());
+    CHECK(device.copies.back().slot == 2);
+    CHECK(texture.GetStats().busySlots == 1);
+
+    // all busy: nothing is copied and the block waits for the next flush
+    device.busy.assign(device.busy.size(), true);
+    size_t copies = device.copies.size();
+    texture.Update(pixels.data(), 8, 4, 4, 2, 2);
+    CHECK(!texture.Flush());
+    CHECK(device.copies.size() == copies);
+    CHECK(texture.IsDirty());
+    CHECK(texture.GetStats().deferred == 1);
+    CHECK(texture.GetStats().busySlots == 1 + DynamicTexture::StagingSlots);
+
+    device.busy.assign(device.busy.size(), false);
+    CHECK(texture.Flush());
+    CHECK(SameCopy(device.copies.back(), 4, 4, 2, 2));
+    CHECK(!texture.IsDirty());
+    CHECK(device.texture == texture.GetImage());
+}
+
+TEST(DynamicTextureTakesImagesOverWithoutCopying)
+{
+    const int width = 16, height = 8;
+    FakeStagingDevice device;
+    DynamicTexture texture(&device, width, height);
+    texture.Flush();
+
+    std::vector<uint32_t> first = Pattern(width, height, 1);
+    const uint32_t* firstData = first.data();
+    const uint32_t* initialData = texture.GetImage().data();
+
+    // swapped in: the texture now owns the buffer, the caller gets the old image
+    std::vector<uint32_t> previous = texture.Update(std::move(first), 2, 2, 4, 4);
+    CHECK(texture.GetImage().data() == firstData);
+    CHECK(previous.data() == initialData);
+    CHECK(previous.size() == (size_t)width * height);
+    CHECK(previous[5] == 0);
+    CHECK(texture.GetStats().bytesCopied == 0);
+
+    CHECK(texture.Flush());
+    CHECK(SameCopy(device.copies.back(), 2, 2, 4, 4));
+
+    // the returned buffer goes back in with the next image
+    previous.assign(previous.size(), 0x12345678u);
+    std::vector<uint32_t> second = texture.Update(std::move(previous), 0, 0, width, height);
+    CHECK(second.data() == firstData);
+    CHECK(texture.GetImage()[0] == 0x12345678u);
+
+    // wrong size: handed straight back, image and dirty rect unchanged
+    texture.Flush();
+    std::vector<uint32_t> small(10, 0xffffffffu);
+    const uint32_t* smallData = small.data();
+    std::vector<uint32_t> returned = texture.Update(std::move(small), 0, 0, width, height);
+    CHECK(returned.data() == smallData);
+    CHECK(returned.size() == 10);
+    CHECK(texture.GetImage()[0] == 0x12345678u);
+    CHECK(!texture.IsDirty());
+}
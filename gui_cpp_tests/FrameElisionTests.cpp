@@ -0,0 +1,81 @@
+#include "Test.h"
+#include "Renderer.h"
+#include "TestBackends.h"
+
+#include <string>
+
+// A cached window plus an FPS style overlay drawn outside the windows, the
+// way Window::displayFPS draws it
+static void BuildFrame(Renderer& renderer, const std::string& overlay)
+{
+    renderer.Begin();
+    Renderer::Ui& ui = renderer.GetUI();
+    ui.BeginWindow("Dashboard", 20.f, 40.f, 200.f, 160.f);
+    ui.AddText("Status", Color(1.f, 1.f, 1.f, 1.f));
+    ui.AddButton("Refresh");
+    ui.EndWindow();
+
+    int channel = renderer.GetChannel();
+    renderer.SetChannel(OverlayChannel);
+    renderer.AddText(300.f, 10.f, overlay, Color(1.f, 1.f, 1.f, 1.f));
+    renderer.SetChannel(channel);
+    renderer.End();
+}
+
+TEST(FrameElisionSkipsUnchangedOverlay)
+{
+    CaptureBackend backend;
+    Renderer renderer(nullptr, nullptr);
+    renderer.SetWindowSize(640, 480);
+    renderer.SetBackend(&backend);
+
+    BuildFrame(renderer, "FPS: 60");
+    CHECK(!renderer.IsFrameElided());
+    CHECK(backend.frameCount == 1);
+
+    // same overlay text: nothing to upload
+    for (int i = 0; i < 3; i++) {
+        BuildFrame(renderer, "FPS: 60");
+        CHECK(renderer.IsFrameElided());
+    }
+    CHECK(renderer.GetElidedFrameCount() == 3);
+    CHECK(backend.frameCount == 1);
+
+    // the counter ticks: that frame goes through, the next one is idle again
+    BuildFrame(renderer, "FPS: 59");
+    CHECK(!renderer.IsFrameElided());
+    CHECK(backend.frameCount == 2);
+    BuildFrame(renderer, "FPS: 59");
+    CHECK(renderer.IsFrameElided());
+    CHECK(renderer.GetElidedFrameCount() == 4);
+}
+
+TEST(FrameElisionSeesOverlayMoves)
+{
+    CaptureBackend backend;
+    Renderer renderer(nullptr, nullptr);
+    renderer.SetWindowSize(640, 480);
+    renderer.SetBackend(&backend);
+
+    BuildFrame(renderer, "FPS: 60");
+    BuildFrame(renderer, "FPS: 60");
+    CHECK(renderer.IsFrameElided());
+
+    // same text in another channel is another picture
+    renderer.Begin();
+    renderer.GetUI().BeginWindow("Dashboard", 20.f, 40.f, 200.f, 160.f);
+    renderer.GetUI().AddText("Status", Color(1.f, 1.f, 1.f, 1.f));
+    renderer.GetUI().AddButton("Refresh");
+    renderer.GetUI().EndWindow();
+    renderer.AddText(300.f, 10.f, "FPS: 60", Color(1.f, 1.f, 1.f, 1.f));
+    renderer.End();
+    CHECK(!renderer.IsFrameElided());
+
+    // and an explicit invalidation always goes through
+    BuildFrame(renderer, "FPS: 60");
+    BuildFrame(renderer, "FPS: 60");
+    CHECK(renderer.IsFrameElided());
+    renderer.InvalidateFrame();
+    BuildFrame(renderer, "FPS: 60");
+    CHECK(!renderer.IsFrameElided());
+}
@@ -0,0 +1,129 @@
+#include "Test.h"
+#include "Renderer.h"
+#include "TestBackends.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+template <typename T, typename A>
+static bool SameBytes(const std::vector<T, A>& a, const std::vector<T, A>& b)
+{
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+// field by field, DrawCommand has padding
+static bool SameCommands(const std::vector<DrawCommand>& a, const std::vector<DrawCommand>& b)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].vtxOffset != b[i].vtxOffset || a[i].idxOffset != b[i].idxOffset || a[i].elemCount != b[i].elemCount ||
+            a[i].texture != b[i].texture || a[i].clipRect != b[i].clipRect || a[i].instOffset != b[i].instOffset ||
+            a[i].instCount != b[i].instCount || a[i].instVertexCount != b[i].instVertexCount ||
+            a[i].shapeInstances != b[i].shapeInstances)
+            return false;
+    }
+    return true;
+}
+
+static bool SameFrame(const CaptureBackend& a, const CaptureBackend& b)
+{
+    return SameBytes(a.list.vtxBuffer, b.list.vtxBuffer) && SameBytes(a.list.idxBuffer, b.list.idxBuffer) &&
+        SameCommands(a.list.cmdBuffer, b.list.cmdBuffer) && SameBytes(a.list.instBuffer, b.list.instBuffer) &&
+        SameBytes(a.list.shapeBuffer, b.list.shapeBuffer);
+}
+
+// Tessellated arcs, so the build depends on the circle tolerance. Uncached,
+// its window is rebuilt every frame.
+struct ArcComponent : public Renderer::Ui::Component {
+    float radius = 10.f;
+
+    void Update(const Renderer::Ui::Context& ctx, float offsetX, float offsetY) override {}
+
+    void Draw(Renderer* renderer, float offsetX, float offsetY) override {
+        Vec2 center = { offsetX + 20.f + radius, offsetY + 10.f + radius };
+        renderer->PathArcTo(center, radius, 0.f, 6.2831853f);
+        renderer->PathFillConvex(Color(0.2f, 0.6f, 0.9f, 1.f));
+        renderer->PathArcTo({ center.x + 2.f * radius + 10.f, center.y }, radius, 0.f, 3.1415926f);
+        renderer->PathStroke(Color(1.f, 1.f, 1.f, 1.f), false, 2.f);
+        renderer->AddRectangleFilled({ offsetX + 10.f, offsetY + 2.f * radius + 20.f }, { 110.f, 24.f }, Color(0.4f, 0.4f, 0.4f, 1.f), 6.f);
+    }
+};
+
+static void BuildFrame(Renderer& renderer, int frame)
+{
+    static float sliderValues[6] = { 0.1f, 0.2f, 0.3f, 0.4f, 0.5f, 0.6f };
+    static bool checks[6] = { true, false, true, false, true, false };
+
+    renderer.Begin();
+    Renderer::Ui& ui = renderer.GetUI();
+    for (int i = 0; i < 6; i++) {
+        Renderer::Ui::Window* win = ui.BeginWindow("Window " + std::to_string(i), 20.f + i * 190.f, 40.f + (i % 2) * 300.f, 180.f, 280.f);
+        ui.AddText("Frame " + std::to_string(frame), Color(1.f, 1.f, 1.f, 1.f));
+        ui.AddSlider("Value", &sliderValues[i]);
+        ui.AddCheckbox("Enabled", &checks[i]);
+        ui.AddButton("Apply");
+
+        auto arcs = std::make_unique<ArcComponent>();
+        arcs->radius = 8.f + i * 4.f + (frame % 3) * 5.f;
+        arcs->culled = false;
+        win->components.push_back(std::move(arcs));
+        ui.EndWindow();
+    }
+    renderer.End();
+}
+
+static void SetUpHeadless(Renderer& renderer, CaptureBackend& backend, bool parallel)
+{
+    renderer.SetWindowSize(1200, 720);
+    renderer.SetBackend(&backend);
+    renderer.SetFrameElision(false);
+    renderer.GetUI().SetParallelBuild(parallel);
+}
+
+TEST(ParallelBuildMatchesSerial)
+{
+    CaptureBackend serialFrame, parallelFrame;
+    Renderer serial(nullptr, nullptr), parallel(nullptr, nullptr);
+    SetUpHeadless(serial, serialFrame, false);
+    SetUpHeadless(parallel, parallelFrame, true);
+
+    for (int frame = 0; frame < 8; frame++) {
+        BuildFrame(serial, frame);
+        BuildFrame(parallel, frame);
+        CHECK(serialFrame.list.GetIndexCount() > 0);
+        CHECK(parallel.GetUI().GetRebuiltWindowCount() > 1);
+        CHECK(SameFrame(serialFrame, parallelFrame));
+    }
+}
+
+// SetCircleMaxError from another thread while workers tessellate: every
+// frame still matches a serial build with the tolerance that frame used
+TEST(ParallelBuildWithConcurrentCircleError)
+{
+    CaptureBackend serialFrame, parallelFrame;
+    Renderer serial(nullptr, nullptr), parallel(nullptr, nullptr);
+    SetUpHeadless(serial, serialFrame, false);
+    SetUpHeadless(parallel, parallelFrame, true);
+
+    std::atomic<bool> stop{ false };
+    std::thread setter([&] {
+        const float errors[3] = { 0.05f, 0.3f, 1.5f };
+        for (int i = 0; !stop.load(); i++) {
+            parallel.SetCircleMaxError(errors[i % 3]);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+
+    for (int frame = 0; frame < 60; frame++) {
+        BuildFrame(parallel, frame);
+        serial.SetCircleMaxError(parallel.GetCircleMaxError());
+        BuildFrame(serial, frame);
+        CHECK(serial.GetCircleMaxError() == parallel.GetCircleMaxError());
+        CHECK(SameFrame(serialFrame, parallelFrame));
+    }
+
+    stop = true;
+    setter.join();
+}
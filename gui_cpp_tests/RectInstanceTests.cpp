@@ -0,0 +1,168 @@
+#include "Test.h"
+#include "Renderer.h"
+#include "TestBackends.h"
+
+#include <cstdlib>
+#include <cstring>
+
+struct Triangle {
+    Vec2 p[3];
+    uint32_t col;
+
+    bool operator==(const Triangle& other) const { return memcmp(this, &other, sizeof(Triangle)) == 0; }
+};
+
+// Triangles of the indexed commands, the CPU fallback
+static std::vector<Triangle> IndexedTriangles(const DrawList& list)
+{
+    std::vector<Triangle> out;
+    for (const DrawCommand& cmd : list.cmdBuffer) {
+        if (cmd.instCount > 0) continue;
+        for (UINT e = 0; e + 2 < cmd.elemCount; e += 3) {
+            Triangle tri;
+            for (int k = 0; k < 3; k++) {
+                const Vertex& v = list.vtxBuffer[cmd.vtxOffset + list.idxBuffer[cmd.idxOffset + e + k]];
+                tri.p[k] = { v.x, v.y };
+                tri.col = v.col;
+            }
+            out.push_back(tri);
+        }
+    }
+    return out;
+}
+
+// Triangles of the instanced commands, expanded with RectInstanceVertex like
+// the vertex shader. The padding of sharp rects in a rounded batch is left
+// out but counted, and must collapse to a point.
+static std::vector<Triangle> InstancedTriangles(const DrawList& list, int& padding, bool& paddingCollapsed)
+{
+    std::vector<Triangle> out;
+    padding = 0;
+    paddingCollapsed = true;
+    for (const DrawCommand& cmd : list.cmdBuffer) {
+        if (cmd.instCount == 0 || cmd.shapeInstances) continue;
+        for (UINT i = 0; i < cmd.instCount; i++) {
+            const RectInstance& rect = list.instBuffer[cmd.instOffset + i];
+            for (UINT v = 0; v + 2 < cmd.instVertexCount; v += 3) {
+                Triangle tri;
+                for (int k = 0; k < 3; k++) tri.p[k] = RectInstanceVertex(rect, (int)(v + k));
+                tri.col = rect.col;
+
+                if (v >= RectInstanceVertexCount(rect)) {
+                    padding++;
+                    for (int k = 0; k < 3; k++)
+                        paddingCollapsed &= tri.p[k].x == rect.x && tri.p[k].y == rect.y;
+                    continue;
+                }
+                out.push_back(tri);
+            }
+        }
+    }
+    return out;
+}
+
+struct RectCase {
+    Vec2 topLeft, size;
+    float rounding;
+    Color color;
+};
+
+static const RectCase rectCases[] = {
+    { { 10.f, 10.f }, { 50.f, 20.f }, 0.f, Color(1.f, 0.f, 0.f, 1.f) },         // sharp
+    { { 70.5f, 10.25f }, { 33.3f, 17.7f }, 0.f, Color(0.f, 1.f, 0.f, 1.f) },    // sharp, fractional
+    { { 10.f, 40.f }, { 80.f, 40.f }, 8.f, Color(0.f, 0.f, 1.f, 1.f) },         // rounded
+    { { 100.f, 40.f }, { 10.f, 30.f }, 20.f, Color(1.f, 1.f, 0.f, 0.5f) },      // rounding clamped to half the width
+    { { 120.f, 40.f }, { 40.f, 40.f }, 0.25f, Color(1.f, 0.f, 1.f, 1.f) },      // too small to round: sharp
+    { { 170.f, 40.f }, { 24.f, 24.f }, 12.f, Color(0.f, 1.f, 1.f, 1.f) },       // a circle
+    { { 200.f, 40.f }, { 30.f, 10.f }, 0.f, Color(0.5f, 0.5f, 0.5f, 1.f) },     // sharp after rounded: padded
+    { { 240.f, 90.f }, { -30.f, -20.f }, 5.f, Color(1.f, 1.f, 1.f, 1.f) },      // negative size
+};
+
+static void DrawRects(Renderer& renderer, const RectCase* cases, size_t count)
+{
+    renderer.Begin();
+    for (size_t i = 0; i < count; i++)
+        renderer.AddRectangleFilled(cases[i].topLeft, cases[i].size, cases[i].color, cases[i].rounding);
+    renderer.End();
+}
+
+static void ExpandBothWays(const RectCase* cases, size_t count, std::vector<Triangle>& cpu, std::vector<Triangle>& instanced, int& padding, bool& paddingCollapsed)
+{
+    CaptureBackend cpuFrame, instancedFrame;
+    Renderer cpuRenderer(nullptr, nullptr), instancedRenderer(nullptr, nullptr);
+    cpuRenderer.SetBackend(&cpuFrame);
+    instancedRenderer.SetBackend(&instancedFrame);
+    instancedRenderer.SetInstancedRects(true);
+
+    DrawRects(cpuRenderer, cases, count);
+    DrawRects(instancedRenderer, cases, count);
+    CHECK(cpuFrame.list.GetInstanceCount() == 0);
+    CHECK(instancedFrame.list.GetInstanceCount() == count);
+
+    cpu = IndexedTriangles(cpuFrame.list);
+    instanced = InstancedTriangles(instancedFrame.list, padding, paddingCollapsed);
+}
+
+TEST(RectInstanceSharpMatchesCpu)
+{
+    std::vector<Triangle> cpu, instanced;
+    int padding = 0;
+    bool collapsed = false;
+    ExpandBothWays(rectCases, 2, cpu, instanced, padding, collapsed);
+
+    CHECK(cpu.size() == 4);
+    CHECK(padding == 0);
+    CHECK(cpu == instanced);
+}
+
+TEST(RectInstanceRoundedMatchesCpu)
+{
+    std::vector<Triangle> cpu, instanced;
+    int padding = 0;
+    bool collapsed = false;
+    ExpandBothWays(rectCases + 2, 2, cpu, instanced, padding, collapsed);
+
+    CHECK(cpu.size() == 2 * (RoundedRectVertices / 3));
+    CHECK(padding == 0);
+    CHECK(cpu == instanced);
+}
+
+TEST(RectInstanceMixedBatchPadsSharpRects)
+{
+    const size_t count = sizeof(rectCases) / sizeof(rectCases[0]);
+    std::vector<Triangle> cpu, instanced;
+    int padding = 0;
+    bool collapsed = false;
+    ExpandBothWays(rectCases, count, cpu, instanced, padding, collapsed);
+
+    // four sharp rects (the first two, the 0.25 rounding one and the one
+    // after the circle) drawn with the rounded vertex count of the batch
+    CHECK(padding == 4 * (int)((RoundedRectVertices - SharpRectVertices) / 3));
+    CHECK(collapsed);
+    CHECK(!cpu.empty());
+    CHECK(cpu == instanced);
+}
+
+// The table in the generated shader source reads back to the exact floats
+// RectInstanceVertex uses
+TEST(RectInstanceShaderTableIsBitIdentical)
+{
+    std::string hlsl = RectCornerTableHlsl();
+    const Vec2* corners = RectCornerTable();
+
+    const char* cursor = hlsl.c_str();
+    int entries = 0;
+    bool identical = true;
+    while ((cursor = strstr(cursor, "float2(")) != nullptr) {
+        cursor += strlen("float2(");
+        char* end = nullptr;
+        float x = strtof(cursor, &end);
+        float y = strtof(end + 1, &end);
+        cursor = end;
+        if (entries < RectOutlinePoints)
+            identical &= memcmp(&x, &corners[entries].x, sizeof(float)) == 0 && memcmp(&y, &corners[entries].y, sizeof(float)) == 0;
+        entries++;
+    }
+    CHECK(entries == RectOutlinePoints);
+    CHECK(identical);
+}
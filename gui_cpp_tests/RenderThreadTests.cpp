@@ -0,0 +1,163 @@
+#include "Test.h"
+#include "Renderer.h"
+#include "RenderBackend.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Holds every frame in RenderFrame until the test opens the gate, so the
+// test can see what the app thread does while a frame is in flight
+class GatedBackend : public SoftwareBackend {
+public:
+    void RenderFrame(const DrawList& list, int width, int height) override {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            rendering = true;
+            changed.notify_all();
+            changed.wait(lock, [this] { return open || released > 0; });
+            if (!open) released--;
+        }
+        SoftwareBackend::RenderFrame(list, width, height);
+        std::lock_guard<std::mutex> lock(mutex);
+        rendering = false;
+    }
+
+    void WaitUntilRendering() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return rendering; });
+    }
+    void Release() {
+        std::lock_guard<std::mutex> lock(mutex);
+        released++;
+        changed.notify_all();
+    }
+    void Open() {
+        std::lock_guard<std::mutex> lock(mutex);
+        open = true;
+        changed.notify_all();
+    }
+    bool IsRendering() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return rendering;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool rendering = false;
+    bool open = false;
+    int released = 0;
+};
+
+// Moving shapes, so every frame differs from the one before
+static void BuildFrame(Renderer& renderer, int frame)
+{
+    renderer.Begin();
+    for (int i = 0; i < 12; i++) {
+        float x = 10.f + (float)((i * 37 + frame * 11) % 150);
+        float y = 8.f + (float)((i * 23 + frame * 7) % 70);
+        renderer.AddRectangleFilled({ x, y }, { 24.f, 16.f }, Color(0.1f * (i % 10), 0.5f, 1.f - 0.08f * i, 0.75f), i % 3 == 0 ? 5.f : 0.f);
+    }
+    renderer.AddCircleAnalytic({ 100.f + frame * 3.f, 50.f }, 18.f, Color(1.f, 0.8f, 0.2f, 0.6f), 4.f);
+    renderer.AddLine({ 5.f, 5.f }, { 190.f, 5.f + frame * 4.f }, Color(1.f, 1.f, 1.f, 1.f), 2.f);
+    renderer.AddText(20.f, 70.f, "Frame " + std::to_string(frame), Color(0.9f, 0.9f, 0.9f, 1.f));
+    renderer.End();
+}
+
+static void SetUpHeadless(Renderer& renderer, RenderBackend& backend, bool threaded)
+{
+    renderer.SetWindowSize(200, 100);
+    renderer.SetBackend(&backend);
+    renderer.SetFrameElision(false);
+    renderer.SetThreadedRendering(threaded);
+}
+
+TEST(RenderThreadMatchesDirectRendering)
+{
+    SoftwareBackend direct, threaded;
+    Renderer directRenderer(nullptr, nullptr), threadedRenderer(nullptr, nullptr);
+    SetUpHeadless(directRenderer, direct, false);
+    SetUpHeadless(threadedRenderer, threaded, true);
+    CHECK(threadedRenderer.IsThreadedRendering());
+
+    for (int frame = 0; frame < 20; frame++) {
+        BuildFrame(directRenderer, frame);
+        BuildFrame(threadedRenderer, frame);
+        threadedRenderer.WaitForRenderThread();
+
+        // once per submitted frame, and the render thread presents each
+        CHECK(threaded.GetFrameCount() == (uint64_t)frame + 1);
+        CHECK(threaded.GetPresentCount() == (uint64_t)frame + 1);
+        CHECK(direct.GetPresentCount() == 0);
+        CHECK(threaded.GetWidth() == 200 && threaded.GetHeight() == 100);
+        CHECK(threaded.GetPixels() == direct.GetPixels());
+    }
+}
+
+// Submit waits for the frame before it: the app is at most one frame ahead
+TEST(RenderThreadBoundsLatency)
+{
+    GatedBackend backend;
+    Renderer renderer(nullptr, nullptr);
+    SetUpHeadless(renderer, backend, true);
+
+    BuildFrame(renderer, 0);
+    backend.WaitUntilRendering();
+
+    // frame 1 is built while frame 0 renders, but not handed over
+    std::atomic<bool> submitted{ false };
+    std::thread app([&] {
+        BuildFrame(renderer, 1);
+        submitted = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(!submitted);
+    CHECK(backend.GetFrameCount() == 0);
+
+    backend.Release();
+    app.join();
+    CHECK(submitted);
+
+    backend.Open();
+    renderer.WaitForRenderThread();
+    CHECK(backend.GetFrameCount() == 2);
+    CHECK(backend.GetPresentCount() == 2);
+}
+
+// The resize handoff: once WaitForRenderThread returns nothing renders, the
+// size can change, and the next frame comes out at the new size
+TEST(RenderThreadResizeHandoff)
+{
+    GatedBackend backend;
+    Renderer renderer(nullptr, nullptr);
+    SetUpHeadless(renderer, backend, true);
+
+    BuildFrame(renderer, 0);
+    backend.WaitUntilRendering();
+    std::thread opener([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        backend.Open();
+    });
+    renderer.WaitForRenderThread();
+    CHECK(!backend.IsRendering());
+    CHECK(backend.GetFrameCount() == 1);
+    CHECK(backend.GetWidth() == 200);
+    opener.join();
+
+    renderer.SetWindowSize(320, 240);
+    BuildFrame(renderer, 1);
+    renderer.WaitForRenderThread();
+    CHECK(backend.GetFrameCount() == 2);
+    CHECK(backend.GetWidth() == 320 && backend.GetHeight() == 240);
+    CHECK(backend.GetPixels().size() == (size_t)320 * 240);
+
+    // turning the thread off finishes the frame in flight first
+    BuildFrame(renderer, 2);
+    renderer.SetThreadedRendering(false);
+    CHECK(!renderer.IsThreadedRendering());
+    CHECK(backend.GetFrameCount() == 3);
+    CHECK(backend.GetPresentCount() == 3);
+}
@@ -0,0 +1,107 @@
+#include "Test.h"
+#include "Renderer.h"
+#include "RenderBackend.h"
+
+#include <cmath>
+
+static bool Near(float a, float b, float tolerance = 0.02f) { return std::fabs(a - b) <= tolerance; }
+
+static ShapeInstance MakeShape(float x, float y, float w, float h, float radius, float thickness)
+{
+    ShapeInstance s;
+    s.x = x; s.y = y; s.w = w; s.h = h;
+    s.col = 0xffffffff;
+    s.radius = radius;
+    s.thickness = thickness;
+    return s;
+}
+
+TEST(ShapeCoverageRoundedRect)
+{
+    ShapeInstance s = MakeShape(10.f, 20.f, 60.f, 40.f, 8.f, 0.f);
+
+    CHECK(ShapeCoverage(s, 40.f, 40.f) == 1.f);
+    CHECK(ShapeCoverage(s, 12.f, 40.f) == 1.f);
+    CHECK(ShapeCoverage(s, 5.f, 40.f) == 0.f);
+    CHECK(ShapeCoverage(s, 40.f, 70.f) == 0.f);
+
+    // half covered on the straight edges
+    CHECK(Near(ShapeCoverage(s, 10.f, 40.f), 0.5f));
+    CHECK(Near(ShapeCoverage(s, 70.f, 40.f), 0.5f));
+    CHECK(Near(ShapeCoverage(s, 40.f, 20.f), 0.5f));
+    CHECK(Near(ShapeCoverage(s, 40.f, 60.f), 0.5f));
+
+    // and on the corner arc, which cuts the corner of the bounds off
+    float d = 8.f / std::sqrt(2.f);
+    CHECK(Near(ShapeCoverage(s, 18.f - d, 28.f - d), 0.5f));
+    CHECK(ShapeCoverage(s, 10.5f, 20.5f) == 0.f);
+}
+
+TEST(ShapeCoverageCircle)
+{
+    // radius = half the side
+    ShapeInstance s = MakeShape(50.f, 50.f, 40.f, 40.f, 20.f, 0.f);
+
+    CHECK(ShapeCoverage(s, 70.f, 70.f) == 1.f);
+    CHECK(ShapeCoverage(s, 70.f, 52.f) == 1.f);
+    CHECK(ShapeCoverage(s, 70.f, 45.f) == 0.f);
+    for (int i = 0; i < 8; i++) {
+        float angle = i * 0.7853982f + 0.3f;
+        CHECK(Near(ShapeCoverage(s, 70.f + std::cos(angle) * 20.f, 70.f + std::sin(angle) * 20.f), 0.5f));
+        CHECK(ShapeCoverage(s, 70.f + std::cos(angle) * 22.f, 70.f + std::sin(angle) * 22.f) == 0.f);
+    }
+}
+
+TEST(ShapeCoverageRing)
+{
+    // outer radius 20, inner radius 12
+    ShapeInstance s = MakeShape(50.f, 50.f, 40.f, 40.f, 20.f, 8.f);
+
+    CHECK(ShapeCoverage(s, 70.f, 70.f) == 0.f);
+    CHECK(ShapeCoverage(s, 75.f, 70.f) == 0.f);
+    for (int i = 0; i < 8; i++) {
+        float c = std::cos(i * 0.7853982f + 0.3f), sn = std::sin(i * 0.7853982f + 0.3f);
+        CHECK(ShapeCoverage(s, 70.f + c * 16.f, 70.f + sn * 16.f) == 1.f);
+        CHECK(Near(ShapeCoverage(s, 70.f + c * 20.f, 70.f + sn * 20.f), 0.5f));
+        CHECK(Near(ShapeCoverage(s, 70.f + c * 12.f, 70.f + sn * 12.f), 0.5f));
+        CHECK(ShapeCoverage(s, 70.f + c * 10.f, 70.f + sn * 10.f) == 0.f);
+    }
+}
+
+// The software backend blends the shape's alpha times ShapeCoverage at
+// every pixel centre: opaque white over black comes out as the coverage
+TEST(ShapeSoftwareBackendMatchesCoverage)
+{
+    SoftwareBackend backend;
+    Renderer renderer(nullptr, nullptr);
+    renderer.SetWindowSize(200, 100);
+    renderer.SetBackend(&backend);
+
+    Color white(1.f, 1.f, 1.f, 1.f);
+    renderer.Begin();
+    renderer.AddRectRounded({ 10.5f, 10.f }, { 50.f, 30.25f }, white, 7.f);
+    renderer.AddCircleAnalytic({ 100.f, 40.f }, 20.3f, white);
+    renderer.AddRing({ 160.f, 40.f }, 10.5f, 25.f, white);
+    renderer.End();
+    CHECK(backend.GetFrameCount() == 1);
+
+    const ShapeInstance shapes[3] = {
+        MakeShape(10.5f, 10.f, 50.f, 30.25f, 7.f, 0.f),
+        MakeShape(100.f - 20.3f, 40.f - 20.3f, 40.6f, 40.6f, 20.3f, 0.f),
+        MakeShape(135.f, 15.f, 50.f, 50.f, 25.f, 14.5f),
+    };
+    const std::vector<uint32_t>& pixels = backend.GetPixels();
+    int mismatches = 0, edgePixels = 0;
+    for (const ShapeInstance& s : shapes) {
+        for (int y = (int)s.y - 2; y < (int)(s.y + s.h) + 2; y++) {
+            for (int x = (int)s.x - 2; x < (int)(s.x + s.w) + 2; x++) {
+                float coverage = ShapeCoverage(s, x + 0.5f, y + 0.5f);
+                if (coverage > 0.f && coverage < 1.f) edgePixels++;
+                uint32_t expected = (uint32_t)(255.f * coverage + 0.5f);
+                if ((pixels[(size_t)y * 200 + x] & 0xff) != expected) mismatches++;
+            }
+        }
+    }
+    CHECK(edgePixels > 100);
+    CHECK(mismatches == 0);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <iostream>
+#include <vector>
+
+// Just enough of a test framework for the renderer: TEST(Name) { ... }
+// registers a test, CHECK(cond) reports a failed condition and carries on.
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+inline std::vector<TestCase>& TestRegistry()
+{
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+inline int& TestFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+struct TestRegistrar {
+    TestRegistrar(const char* name, void (*run)()) { TestRegistry().push_back({ name, run }); }
+};
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistrar name##Registrar(#name, &name); \
+    static void name()
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << "(" << __LINE__ << "): CHECK(" #cond ") failed\n"; \
+            TestFailures()++; \
+        } \
+    } while (0)
@@ -0,0 +1,17 @@
+#pragma once
+#include "RenderBackend.h"
+
+// Keeps a copy of the last submitted frame and counts the frames and
+// presents, for headless renderers (Renderer(nullptr, nullptr))
+class CaptureBackend : public RenderBackend {
+public:
+    void RenderFrame(const DrawList& frame, int width, int height) override {
+        list = frame;
+        frameCount++;
+    }
+    void Present() override { presentCount++; }
+
+    DrawList list;
+    uint64_t frameCount = 0;
+    uint64_t presentCount = 0;
+};
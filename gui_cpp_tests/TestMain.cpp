@@ -0,0 +1,17 @@
+#include "Test.h"
+
+// Runs every registered test, the exit code is the number of failed checks
+int main()
+{
+    int failedTests = 0;
+    for (const TestCase& test : TestRegistry()) {
+        int before = TestFailures();
+        test.run();
+        bool passed = TestFailures() == before;
+        if (!passed) failedTests++;
+        std::cout << (passed ? "[ ok ] " : "[FAIL] ") << test.name << "\n";
+    }
+
+    std::cout << TestRegistry().size() - failedTests << "/" << TestRegistry().size() << " tests passed\n";
+    return TestFailures();
+}
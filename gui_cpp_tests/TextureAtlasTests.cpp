@@ -0,0 +1,221 @@
+#include "Test.h"
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Pages in CPU memory behind made-up view pointers, every upload recorded
+// and applied so the device side can be compared with the atlas' copy
+class FakeAtlasDevice : public IAtlasDevice {
+public:
+    struct Update { int page, x, y, w, h; };
+    struct FakePage { int width, height; std::vector<uint32_t> pixels; bool released; };
+
+    ID3D11ShaderResourceView* CreatePage(int width, int height) override {
+        pages.push_back({ width, height, std::vector<uint32_t>((size_t)width * height, 0), false });
+        return (ID3D11ShaderResourceView*)(uintptr_t)pages.size();
+    }
+
+    void UpdatePage(ID3D11ShaderResourceView* view, int x, int y, int w, int h, const uint32_t* pixels, int pitch) override {
+        int page = Index(view);
+        updates.push_back({ page, x, y, w, h });
+        for (int row = 0; row < h; row++)
+            for (int col = 0; col < w; col++)
+                pages[page].pixels[(size_t)(y + row) * pages[page].width + x + col] = pixels[(size_t)row * pitch + col];
+    }
+
+    void ReleasePage(ID3D11ShaderResourceView* view) override { pages[Index(view)].released = true; }
+
+    static int Index(ID3D11ShaderResourceView* view) { return (int)(uintptr_t)view - 1; }
+
+    std::vector<FakePage> pages;
+    std::vector<Update> updates;
+};
+
+static std::vector<uint32_t> Image(int width, int height, uint32_t seed)
+{
+    std::vector<uint32_t> pixels((size_t)width * height);
+    for (size_t i = 0; i < pixels.size(); i++) pixels[i] = 0xff000000u | ((uint32_t)(seed * 0x10101u + i * 2654435761u) & 0xffffffu);
+    return pixels;
+}
+
+static bool Overlaps(int ax, int ay, int aw, int ah, int bx, int by, int bw, int bh)
+{
+    return ax < bx + bw && bx < ax + aw && ay < by + bh && by < ay + ah;
+}
+
+TEST(SkylinePacksWithoutOverlap)
+{
+    SkylinePacker packer;
+    packer.Reset(256, 128);
+
+    struct Placed { int x, y, w, h; };
+    std::vector<Placed> placed;
+    uint32_t seed = 12345;
+    int area = 0;
+    for (int i = 0; i < 400; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        int w = 3 + (int)(seed >> 8) % 29, h = 3 + (int)(seed >> 20) % 23;
+        int x = -1, y = -1;
+        if (!packer.Pack(w, h, x, y)) continue;
+        CHECK(x >= 0 && y >= 0 && x + w <= 256 && y + h <= 128);
+        for (const Placed& p : placed)
+            CHECK(!Overlaps(x, y, w, h, p.x, p.y, p.w, p.h));
+        placed.push_back({ x, y, w, h });
+        area += w * h;
+    }
+    CHECK(placed.size() > 20);
+    CHECK(packer.GetUsedArea() == area);
+
+    // rects that cannot fit at all
+    int x, y;
+    CHECK(!packer.Pack(257, 1, x, y));
+    CHECK(!packer.Pack(1, 129, x, y));
+    CHECK(!packer.Pack(0, 4, x, y));
+}
+
+TEST(SkylineFailsWhenFull)
+{
+    SkylinePacker packer;
+    packer.Reset(64, 64);
+
+    int x, y;
+    for (int i = 0; i < 4; i++) {
+        CHECK(packer.Pack(32, 32, x, y));
+        CHECK(x % 32 == 0 && y % 32 == 0);
+    }
+    CHECK(packer.GetUsedArea() == 64 * 64);
+    CHECK(!packer.Pack(1, 1, x, y));
+
+    // bottom-left: a fresh packer fills the bottom row of the skyline first
+    packer.Reset(64, 64);
+    CHECK(packer.Pack(40, 10, x, y) && x == 0 && y == 0);
+    CHECK(packer.Pack(20, 30, x, y) && x == 40 && y == 0);
+    CHECK(packer.Pack(40, 10, x, y) && x == 0 && y == 10);
+}
+
+TEST(AtlasWhiteBlockAndPadding)
+{
+    FakeAtlasDevice device;
+    TextureAtlas atlas(&device, 64);
+
+    std::vector<uint32_t> image = Image(10, 8, 1);
+    ImageId id = atlas.Add(image.data(), 10, 8);
+    CHECK(id == 0);
+    CHECK(atlas.GetPageCount() == 1);
+
+    const std::vector<uint32_t>& page = atlas.GetPagePixels(0);
+    for (int y = 0; y < TextureAtlas::WhiteSize; y++)
+        for (int x = 0; x < TextureAtlas::WhiteSize; x++)
+            CHECK(page[(size_t)y * 64 + x] == 0xffffffffu);
+
+    // the image itself, then each padding pixel repeats the nearest edge pixel
+    AtlasRegion r = atlas.GetRegion(id);
+    CHECK(r.page == 0 && r.width == 10 && r.height == 8);
+    const int pad = TextureAtlas::Padding;
+    for (int y = -pad; y < 8 + pad; y++) {
+        for (int x = -pad; x < 10 + pad; x++) {
+            uint32_t expected = image[(size_t)std::clamp(y, 0, 7) * 10 + std::clamp(x, 0, 9)];
+            CHECK(page[(size_t)(r.y + y) * 64 + r.x + x] == expected);
+        }
+    }
+
+    // and the white block's padding does not overlap it
+    CHECK(!Overlaps(r.x - pad, r.y - pad, 10 + 2 * pad, 8 + 2 * pad, 0, 0, TextureAtlas::WhiteSize + pad, TextureAtlas::WhiteSize + pad));
+    CHECK(atlas.GetRegion(7).page == -1);
+    CHECK(atlas.Add(nullptr, 4, 4) == InvalidImage);
+    CHECK(atlas.Add(image.data(), 0, 4) == InvalidImage);
+}
+
+TEST(AtlasUvsMatchRegion)
+{
+    FakeAtlasDevice device;
+    TextureAtlas atlas(&device, 64);
+
+    for (int i = 0; i < 6; i++) {
+        int w = 5 + i * 3, h = 4 + i * 2;
+        std::vector<uint32_t> image = Image(w, h, i);
+        AtlasRegion r = atlas.GetRegion(atlas.Add(image.data(), w, h));
+        const FakeAtlasDevice::FakePage& page = device.pages[r.page];
+        CHECK(r.uvMin.x == (float)r.x / page.width);
+        CHECK(r.uvMin.y == (float)r.y / page.height);
+        CHECK(r.uvMax.x == (float)(r.x + w) / page.width);
+        CHECK(r.uvMax.y == (float)(r.y + h) / page.height);
+    }
+}
+
+TEST(AtlasOpensPagesForOverflowAndLargeImages)
+{
+    FakeAtlasDevice device;
+    TextureAtlas atlas(&device, 64);
+
+    // 20 x 20 padded to 22 x 22: a 64 page holds a few, then a second opens
+    std::vector<uint32_t> image = Image(20, 20, 3);
+    int lastPage = 0;
+    for (int i = 0; i < 12; i++) {
+        AtlasRegion r = atlas.GetRegion(atlas.Add(image.data(), 20, 20));
+        CHECK(r.page >= lastPage);
+        CHECK(r.x + 20 + TextureAtlas::Padding <= 64 && r.y + 20 + TextureAtlas::Padding <= 64);
+        lastPage = r.page;
+    }
+    CHECK(atlas.GetPageCount() >= 2);
+    CHECK(lastPage == atlas.GetPageCount() - 1);
+
+    // larger than a page: a page of its own, with room for the white block
+    std::vector<uint32_t> large = Image(100, 80, 4);
+    ImageId id = atlas.Add(large.data(), 100, 80);
+    AtlasRegion r = atlas.GetRegion(id);
+    CHECK(r.page == atlas.GetPageCount() - 1);
+    const FakeAtlasDevice::FakePage& page = device.pages[r.page];
+    CHECK(page.width >= 100 + 2 * TextureAtlas::Padding);
+    CHECK(page.height >= 80 + 2 * TextureAtlas::Padding);
+    CHECK(r.x + 100 <= page.width && r.y + 80 <= page.height);
+    CHECK(atlas.GetPagePixels(r.page)[0] == 0xffffffffu);
+    CHECK(atlas.GetPagePixels(r.page)[(size_t)r.y * page.width + r.x] == large[0]);
+
+    // a small image still goes into the first page with room
+    std::vector<uint32_t> tiny = Image(2, 2, 5);
+    CHECK(atlas.GetRegion(atlas.Add(tiny.data(), 2, 2)).page < r.page);
+}
+
+TEST(AtlasFlushesMergedDirtyRect)
+{
+    FakeAtlasDevice device;
+    {
+        TextureAtlas atlas(&device, 64);
+        std::vector<uint32_t> a = Image(6, 6, 6), b = Image(9, 4, 7);
+
+        // a new page uploads whole
+        ImageId first = atlas.Add(a.data(), 6, 6);
+        atlas.Flush();
+        CHECK(device.updates.size() == 1);
+        const FakeAtlasDevice::Update& whole = device.updates[0];
+        CHECK(whole.x == 0 && whole.y == 0 && whole.w == 64 && whole.h == 64);
+
+        // nothing added, nothing uploaded
+        atlas.Flush();
+        CHECK(device.updates.size() == 1);
+
+        // two adds, one upload of the box around both padded images
+        ImageId second = atlas.Add(b.data(), 9, 4);
+        ImageId third = atlas.Add(a.data(), 6, 6);
+        atlas.Flush();
+        CHECK(device.updates.size() == 2);
+        const FakeAtlasDevice::Update& merged = device.updates[1];
+        const int pad = TextureAtlas::Padding;
+        AtlasRegion rb = atlas.GetRegion(second), rc = atlas.GetRegion(third);
+        CHECK(merged.x == std::min(rb.x, rc.x) - pad);
+        CHECK(merged.y == std::min(rb.y, rc.y) - pad);
+        CHECK(merged.x + merged.w == std::max(rb.x + rb.width, rc.x + rc.width) + pad);
+        CHECK(merged.y + merged.h == std::max(rb.y + rb.height, rc.y + rc.height) + pad);
+
+        // the first image was not touched again
+        AtlasRegion ra = atlas.GetRegion(first);
+        CHECK(!Overlaps(merged.x, merged.y, merged.w, merged.h, ra.x, ra.y, ra.width, ra.height));
+
+        // the device holds what the atlas holds
+        CHECK(device.pages[0].pixels == atlas.GetPagePixels(0));
+    }
+    CHECK(device.pages.size() == 1 && device.pages[0].released);
+}
@@ -0,0 +1,206 @@
+#include "Test.h"
+#include "UploadAllocator.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Backing buffer in CPU memory that records every Create and Map, and
+// refuses buffers larger than maxBytes like a device at its size limit
+class FakeUploadDevice : public IUploadDevice {
+public:
+    bool Create(size_t bytes) override {
+        creates.push_back(bytes);
+        if (bytes > maxBytes) {
+            memory.clear();
+            return false;
+        }
+        memory.assign(bytes, 0);
+        return true;
+    }
+
+    void* Map(bool discard) override {
+        maps.push_back(discard);
+        return memory.empty() ? nullptr : memory.data();
+    }
+
+    void Unmap() override {}
+
+    size_t maxBytes = SIZE_MAX;
+    std::vector<uint8_t> memory;
+    std::vector<size_t> creates;
+    std::vector<bool> maps;
+};
+
+static std::vector<uint8_t> Bytes(size_t count, uint8_t seed)
+{
+    std::vector<uint8_t> bytes(count);
+    for (size_t i = 0; i < count; i++) bytes[i] = (uint8_t)(seed + i * 7);
+    return bytes;
+}
+
+static bool Landed(const FakeUploadDevice& device, size_t offset, const std::vector<uint8_t>& bytes)
+{
+    return offset + bytes.size() <= device.memory.size() && memcmp(device.memory.data() + offset, bytes.data(), bytes.size()) == 0;
+}
+
+TEST(UploadGrowsGeometrically)
+{
+    const size_t vertex = 16;
+    FakeUploadDevice device;
+    UploadAllocator upload(&device, 1024, UploadAllocator::Mode::Discard);
+
+    std::vector<uint8_t> small = Bytes(100, 1);
+    CHECK(upload.Upload(small.data(), small.size()) == 0);
+    CHECK(Landed(device, 0, small));
+    CHECK(device.creates.size() == 1 && device.creates[0] == 1024);
+    upload.EndFrame();
+
+    // a jump past twice the capacity still leaves headroom
+    std::vector<uint8_t> big = Bytes(100 * vertex, 2);
+    CHECK(upload.Upload(big.data(), big.size()) == 0);
+    CHECK(Landed(device, 0, big));
+    CHECK(device.creates.size() == 2);
+    CHECK(upload.GetStats().capacity >= big.size() * 3 / 2);
+    upload.EndFrame();
+
+    // one more vertex per frame: no reallocation for the next one, and only
+    // a few while the frame doubles
+    big.resize(big.size() + vertex);
+    upload.Upload(big.data(), big.size());
+    upload.EndFrame();
+    CHECK(device.creates.size() == 2);
+    while (big.size() < 200 * vertex) {
+        big.resize(big.size() + vertex);
+        CHECK(upload.Upload(big.data(), big.size()) == 0);
+        upload.EndFrame();
+    }
+    CHECK(device.creates.size() <= 4);
+    for (size_t i = 1; i < device.creates.size(); i++)
+        CHECK(device.creates[i] >= device.creates[i - 1] * 2);
+    CHECK(upload.GetStats().reallocations == device.creates.size());
+}
+
+TEST(UploadShrinksAfterHysteresis)
+{
+    FakeUploadDevice device;
+    UploadAllocator upload(&device, 1024, UploadAllocator::Mode::Discard);
+    std::vector<uint8_t> big = Bytes(8000, 3), small = Bytes(100, 4), medium = Bytes(4000, 5);
+
+    upload.Upload(big.data(), big.size());
+    upload.EndFrame();
+    size_t grown = upload.GetStats().capacity;
+    CHECK(grown >= 8000);
+
+    // a frame using a quarter or more breaks the low streak
+    for (size_t i = 0; i < UploadAllocator::ShrinkDelayFrames / 2; i++) {
+        upload.Upload(small.data(), small.size());
+        upload.EndFrame();
+    }
+    CHECK(medium.size() * 4 >= grown);
+    upload.Upload(medium.data(), medium.size());
+    upload.EndFrame();
+
+    for (size_t i = 0; i + 1 < UploadAllocator::ShrinkDelayFrames; i++) {
+        upload.Upload(small.data(), small.size());
+        upload.EndFrame();
+    }
+    CHECK(upload.GetStats().capacity == grown);
+    CHECK(upload.GetStats().reallocations == 1);
+
+    upload.Upload(small.data(), small.size());
+    upload.EndFrame();
+    CHECK(upload.GetStats().capacity == 1024);
+    CHECK(upload.GetStats().reallocations == 2);
+
+    // the shrunk buffer is fresh: the next upload renames it
+    size_t maps = device.maps.size();
+    CHECK(upload.Upload(small.data(), small.size()) == 0);
+    CHECK(device.maps.size() == maps + 1 && device.maps.back());
+}
+
+TEST(UploadRingAppendsAndDiscardsOnWrap)
+{
+    FakeUploadDevice device;
+    UploadAllocator upload(&device, 1024, UploadAllocator::Mode::Ring);
+
+    // 3 frames of 250 bytes need 750, with headroom the ring is 1125 bytes:
+    // four 16-byte aligned slots of 256 before it wraps
+    std::vector<size_t> offsets;
+    for (int frame = 0; frame < 6; frame++) {
+        std::vector<uint8_t> bytes = Bytes(250, (uint8_t)frame);
+        size_t offset = upload.Upload(bytes.data(), bytes.size());
+        CHECK(Landed(device, offset, bytes));
+        offsets.push_back(offset);
+        upload.EndFrame();
+    }
+    CHECK(device.creates.size() == 1 && device.creates[0] == 1125);
+
+    const size_t expected[6] = { 0, 256, 512, 768, 0, 256 };
+    const bool discards[6] = { true, false, false, false, true, false };
+    for (int i = 0; i < 6; i++) {
+        CHECK(offsets[i] == expected[i]);
+        CHECK(device.maps[i] == discards[i]);
+    }
+    CHECK(upload.GetStats().discards == 2);
+
+    // Discard mode renames on every upload and always writes at 0
+    upload.SetMode(UploadAllocator::Mode::Discard);
+    std::vector<uint8_t> bytes = Bytes(250, 9);
+    for (int i = 0; i < 3; i++) {
+        CHECK(upload.Upload(bytes.data(), bytes.size()) == 0);
+        CHECK(device.maps.back());
+        upload.EndFrame();
+    }
+    CHECK(upload.GetStats().discards == 5);
+}
+
+TEST(UploadFailsOversizeRequests)
+{
+    FakeUploadDevice device;
+    device.maxBytes = 4096;
+    UploadAllocator upload(&device, 1024, UploadAllocator::Mode::Discard);
+
+    std::vector<uint8_t> oversize = Bytes(5000, 6);
+    CHECK(upload.Upload(oversize.data(), oversize.size()) == UploadAllocator::Failed);
+    CHECK(upload.GetStats().reallocations == 0);
+    CHECK(upload.GetStats().capacity == 0);
+    CHECK(upload.GetStats().bytesUploaded == 0);
+
+    // the headroom does not fit under the limit, the exact size does
+    std::vector<uint8_t> large = Bytes(3000, 7);
+    CHECK(upload.Upload(large.data(), large.size()) == 0);
+    CHECK(Landed(device, 0, large));
+    CHECK(upload.GetStats().capacity == 3000);
+    CHECK(upload.GetStats().reallocations == 1);
+
+    // a map that fails fails the upload too
+    device.memory.clear();
+    CHECK(upload.Upload(large.data(), large.size()) == UploadAllocator::Failed);
+}
+
+TEST(UploadCountsBytesAndReallocations)
+{
+    FakeUploadDevice device;
+    UploadAllocator upload(&device, 1024, UploadAllocator::Mode::Ring);
+    std::vector<uint8_t> a = Bytes(300, 1), b = Bytes(200, 2);
+
+    upload.Upload(a.data(), a.size());
+    upload.Upload(b.data(), b.size());
+    CHECK(upload.GetStats().bytesUploaded == 500);
+    CHECK(upload.GetStats().frameBytes == 0);
+    upload.EndFrame();
+    CHECK(upload.GetStats().frameBytes == 500);
+
+    upload.Upload(b.data(), b.size());
+    upload.EndFrame();
+    CHECK(upload.GetStats().frameBytes == 200);
+    CHECK(upload.GetStats().bytesUploaded == 700);
+
+    // the second upload made the ring hold 3 frames of 500 bytes
+    CHECK(upload.GetStats().reallocations == 2);
+    CHECK(upload.GetStats().reallocations == device.creates.size());
+    CHECK(upload.GetStats().capacity == device.creates.back());
+    CHECK(upload.Upload(nullptr, 0) == 0);
+    CHECK(upload.GetStats().bytesUploaded == 700);
+}